@@ -0,0 +1,157 @@
+#include <client/dual_contour.h>
+#include <client/marching_cubes.h>
+#include <client/terrain_volume_provider.h>
+#include <core/terrain.h>
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <memory>
+#include <vector>
+
+// Offline checks of the surface generators, no window or GL context needed: how often
+// a chunk asks the volume provider for a point, and whether adjacent chunks mesh like
+// one region covering both.
+//
+// Usage: client_bench
+// Exits with an error if a check fails.
+
+namespace {
+
+using Triangle = std::array<glm::vec3, 3>;
+
+constexpr float Tolerance = 0.01f;
+
+void collect_triangles(const IIsoSurfaceGenerator::Mesh& mesh, std::vector<Triangle>& out) {
+    auto corner = [&mesh](size_t index) {
+        return mesh.Packing ? mesh.Packed[index].GetPosition(mesh.Origin) : mesh.Vertices[index];
+    };
+
+    for (size_t i = 0; i + 2 < mesh.Count; i += 3) {
+        Triangle triangle;
+        for (size_t j = 0; j < 3; ++j) {
+            triangle[j] = corner(mesh.Indices.empty() ? i + j : mesh.Indices[i + j]);
+        }
+        out.push_back(triangle);
+    }
+}
+
+float min_x(const Triangle& triangle) {
+    return std::min({ triangle[0].x, triangle[1].x, triangle[2].x });
+}
+
+// Same corners within the tolerance in the same winding, starting anywhere.
+bool same_triangle(const Triangle& a, const Triangle& b) {
+    for (size_t rotation = 0; rotation < 3; ++rotation) {
+        bool same = true;
+        for (size_t i = 0; i < 3 && same; ++i) {
+            same = glm::length(a[i] - b[(i + rotation) % 3]) <= Tolerance;
+        }
+        if (same) {
+            return true;
+        }
+    }
+    return false;
+}
+
+// Meshes two chunks sharing the plane x = low.x + size and one region covering both,
+// the pieces must produce the same triangles, no gaps and no doubles along the seam.
+// Vertices may differ by rounding, the field is interpolated relative to another corner.
+bool check_seam(IIsoSurfaceGenerator& generator, const glm::ivec3& low, int size, size_t& triangles) {
+    const glm::ivec3 extent(size, size, size);
+    const glm::ivec3 step(size, 0, 0);
+
+    std::vector<Triangle> pieces;
+    collect_triangles(generator.Generate(low, low + extent), pieces);
+    collect_triangles(generator.Generate(low + step, low + step + extent), pieces);
+
+    std::vector<Triangle> whole;
+    collect_triangles(generator.Generate(low, low + step + extent), whole);
+
+    triangles = whole.size();
+    if (pieces.size() != whole.size()) {
+        return false;
+    }
+
+    // Every triangle of the whole matches a distinct one of the pieces, candidates are
+    // the pieces whose lowest x is within the tolerance.
+    std::sort(pieces.begin(), pieces.end(), [](const Triangle& a, const Triangle& b) {
+        return min_x(a) < min_x(b);
+    });
+    std::vector<bool> matched(pieces.size(), false);
+    for (const Triangle& triangle : whole) {
+        const float x = min_x(triangle);
+        auto it = std::partition_point(pieces.begin(), pieces.end(), [x](const Triangle& piece) {
+            return min_x(piece) < x - Tolerance;
+        });
+        bool found = false;
+        for (; it != pieces.end() && min_x(*it) <= x + Tolerance && !found; ++it) {
+            const size_t index = it - pieces.begin();
+            found = !matched[index] && same_triangle(*it, triangle);
+            matched[index] = matched[index] || found;
+        }
+        if (!found) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Provider points asked for by one Generate over a size^3 cell chunk, the lattice has
+// (size + 1 + apron)^3 points. More means some point is sampled again.
+bool check_samples(IIsoSurfaceGenerator& generator, CountingVolumeProvider& provider, int size, int apron, uint64_t& samples) {
+    const glm::ivec3 low(0, -size / 2, 0);
+    provider.Reset();
+    generator.Generate(low, low + size);
+    samples = provider.GetSamples();
+    const uint64_t side = size + 1 + apron;
+    return samples <= side * side * side;
+}
+
+}
+
+int main() {
+    TerrainVolume volume;
+    auto provider = std::make_shared<CountingVolumeProvider>(std::make_shared<TerrainVolumeProvider>(volume));
+
+    std::unique_ptr<IIsoSurfaceGenerator> generators[] = { std::make_unique<MarchingCubes>(), std::make_unique<DualContour>() };
+    const char* names[] = { "marching cubes", "dual contour" };
+    // Dual contouring also samples the plane below a chunk's low corner.
+    const int aprons[] = { 0, 1 };
+
+    bool failed = false;
+
+    // Sampling every cell's corners on its own took 8 points per cell before crossings and normals.
+    const int size = 16;
+    const double points = (double)(size + 1) * (size + 1) * (size + 1);
+    const double corners = 8.0 * size * size * size;
+    printf("%16s %8s %10s %14s %18s %6s\n", "generator", "normals", "samples", "per point", "per-cell corners", "once");
+    for (size_t i = 0; i < std::size(generators); ++i) {
+        IIsoSurfaceGenerator& generator = *generators[i];
+        generator.SetVolumeProvider(provider);
+        for (bool hard : { false, true }) {
+            generator.SetHardNormals(hard);
+            uint64_t samples = 0;
+            bool ok = check_samples(generator, *provider, size, aprons[i], samples);
+            printf("%16s %8s %10llu %14.2f %18.2f %6s\n", names[i], hard ? "hard" : "soft", (unsigned long long)samples, samples / points, corners / points, ok ? "ok" : "FAILED");
+            failed |= !ok;
+        }
+        generator.SetHardNormals(false);
+    }
+
+    printf("\n%16s %8s %10s %6s\n", "generator", "packed", "triangles", "seam");
+    for (size_t i = 0; i < std::size(generators); ++i) {
+        IIsoSurfaceGenerator& generator = *generators[i];
+        generator.SetVolumeProvider(provider);
+        for (bool packed : { false, true }) {
+            generator.SetPackedVertices(packed);
+            size_t triangles = 0;
+            bool ok = check_seam(generator, glm::ivec3(0, -8, 0), 16, triangles);
+            printf("%16s %8s %10zu %6s\n", names[i], packed ? "yes" : "no", triangles, ok ? "ok" : "FAILED");
+            failed |= !ok;
+        }
+    }
+
+    return failed ? 1 : 0;
+}
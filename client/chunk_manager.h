@@ -0,0 +1,150 @@
+#pragma once
+
+#include <client/iso_surface_generator.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtx/hash.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+struct ChunkManagerConfig {
+    // Cells per chunk edge, neighbouring chunks share their border lattice points.
+    int Size = 16;
+    // Horizontal range in chunks around the focus, chunks are dropped one chunk further out.
+    int Radius = 2;
+    // Vertical chunk range that can contain the surface.
+    int MinY = -1;
+    int MaxY = 0;
+    // Chunks meshed per Update, zero for no limit.
+    size_t ChunksPerUpdate = 8;
+};
+
+// Meshes the generator's volume in fixed-size chunks around a focus point, nearest first.
+// Finished meshes are kept until their chunk is marked dirty or leaves the range.
+class ChunkManager {
+public:
+    struct Chunk {
+        IIsoSurfaceGenerator::Mesh Mesh;
+        bool Dirty = false;
+        // Bumped on every remesh, renderers compare it to know what to upload.
+        uint64_t Version = 0;
+    };
+
+    ChunkManager(std::shared_ptr<IIsoSurfaceGenerator> generator, const ChunkManagerConfig& config)
+        : Generator_(std::move(generator))
+        , Config_(config)
+    {
+        for (int x = -Config_.Radius; x <= Config_.Radius; ++x) {
+            for (int z = -Config_.Radius; z <= Config_.Radius; ++z) {
+                for (int y = Config_.MinY; y <= Config_.MaxY; ++y) {
+                    Offsets_.emplace_back(x, y, z);
+                }
+            }
+        }
+        std::stable_sort(Offsets_.begin(), Offsets_.end(), [](const glm::ivec3& a, const glm::ivec3& b) {
+            return a.x * a.x + a.z * a.z < b.x * b.x + b.z * b.z;
+        });
+    }
+
+    // Meshes missing and dirty chunks in range of focus and drops the ones out of range.
+    // Missing chunks go nearest first. Dirty ones are remeshed in a round robin that resumes
+    // where the previous Update stopped, so the outer chunks keep up with frequent edits.
+    // Returns the number of chunks meshed.
+    size_t Update(const glm::vec3& focus) {
+        const glm::ivec3 center(glm::floor(focus / (float)Config_.Size));
+
+        size_t meshed = 0;
+        const auto full = [&]() {
+            return Config_.ChunksPerUpdate && meshed >= Config_.ChunksPerUpdate;
+        };
+        const auto remesh = [&](const glm::ivec3& coord, Chunk& chunk) {
+            // The generator keeps the old buffers for the next chunk.
+            const glm::ivec3 low = coord * Config_.Size;
+            std::swap(chunk.Mesh, Generator_->Generate(low, low + Config_.Size));
+            chunk.Dirty = false;
+            ++chunk.Version;
+            ++meshed;
+        };
+
+        for (size_t i = 0; i < Offsets_.size() && !full(); ++i) {
+            const glm::ivec3 coord(center.x + Offsets_[i].x, Offsets_[i].y, center.z + Offsets_[i].z);
+            if (!Chunks_.contains(coord)) {
+                remesh(coord, Chunks_[coord]);
+            }
+        }
+
+        const size_t cursor = Cursor_;
+        for (size_t i = 0; i < Offsets_.size() && !full(); ++i) {
+            const size_t index = (cursor + i) % Offsets_.size();
+            const glm::ivec3 coord(center.x + Offsets_[index].x, Offsets_[index].y, center.z + Offsets_[index].z);
+            auto it = Chunks_.find(coord);
+            if (it != Chunks_.end() && it->second.Dirty) {
+                remesh(coord, it->second);
+                Cursor_ = index + 1;
+            }
+        }
+
+        for (auto it = Chunks_.begin(); it != Chunks_.end();) {
+            const glm::ivec3 distance = glm::abs(it->first - center);
+            if (std::max(distance.x, distance.z) > Config_.Radius + 1) {
+                it = Chunks_.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        Meshed_ += meshed;
+        return meshed;
+    }
+
+    // Marks the chunks whose meshes depend on lattice points within [low, high].
+    void MarkDirty(const glm::vec3& low, const glm::vec3& high) {
+        // Border points belong to the chunks on both sides, dual contouring also reads
+        // the plane below a chunk's low corner.
+        const glm::ivec3 first(glm::floor((low - 1.0f) / (float)Config_.Size));
+        const glm::ivec3 last(glm::floor((high + 1.0f) / (float)Config_.Size));
+        for (auto& [coord, chunk] : Chunks_) {
+            if (glm::all(glm::greaterThanEqual(coord, first)) && glm::all(glm::lessThanEqual(coord, last))) {
+                chunk.Dirty = true;
+            }
+        }
+    }
+
+    // For changes to the whole volume or to the generator's settings.
+    void MarkAllDirty() {
+        for (auto& [coord, chunk] : Chunks_) {
+            chunk.Dirty = true;
+        }
+    }
+
+    const std::unordered_map<glm::ivec3, Chunk>& GetChunks() const {
+        return Chunks_;
+    }
+
+    const std::shared_ptr<IIsoSurfaceGenerator>& GetGenerator() const {
+        return Generator_;
+    }
+
+    void SetGenerator(std::shared_ptr<IIsoSurfaceGenerator> generator) {
+        Generator_ = std::move(generator);
+        MarkAllDirty();
+    }
+
+    uint64_t GetMeshed() const {
+        return Meshed_;
+    }
+
+private:
+    std::shared_ptr<IIsoSurfaceGenerator> Generator_;
+    ChunkManagerConfig Config_;
+    // Chunk offsets within the range sorted by horizontal distance.
+    std::vector<glm::ivec3> Offsets_;
+    std::unordered_map<glm::ivec3, Chunk> Chunks_;
+    // Offset index the next dirty chunk search starts at.
+    size_t Cursor_ = 0;
+    uint64_t Meshed_ = 0;
+};
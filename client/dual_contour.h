@@ -1,14 +1,16 @@
 #pragma once
 
 #include <client/qef_simd.h>
-#include <client/thread_pool.h>
+#include <core/thread_pool.h>
 #include <client/iso_surface_generator.h>
+#include <client/scalar_field.h>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
 #include <glm/gtx/hash.hpp>
 
 #include <functional>
+#include <iostream>
 #include <vector>
 #include <unordered_map>
 #include <unordered_set>
@@ -29,14 +31,22 @@ public:
         std::cout << std::thread::hardware_concurrency() << std::endl;
     }
 
+    // Emits the quads of the sign changing lattice edges starting in [low, high). Those on
+    // the low planes need the cells below them, so vertices are placed from low - 1 and
+    // adjacent chunks share no edge and leave no gap.
     Mesh& Generate(const glm::ivec3& low, const glm::ivec3& high) override {
+        const glm::ivec3 first = low - 1;
+        // Crossing normals feed the QEF, so normals are sampled even for hard shading.
+        Field_.Sample(*VolumeProvider_, first, high, true, ThreadPool_, Shards_);
+
         std::array<std::future<void>, Shards_> results;
         for (size_t i = 0; i < Shards_; ++i) {
-            results[i] = ThreadPool_.enqueue([i, this, &low, &high]() {
+            results[i] = ThreadPool_.enqueue([i, this, &first, &high]() {
+                Mapping_[(first.x + i) & (Shards_ - 1)].clear();
                 glm::ivec3 pos;
-                for (pos.x = low.x + i; pos.x < high.x; pos.x += Shards_) {
-                    for (pos.y = low.y; pos.y < high.y; ++pos.y) {
-                        for (pos.z = low.z; pos.z < high.z; ++pos.z) {
+                for (pos.x = first.x + i; pos.x < high.x; pos.x += Shards_) {
+                    for (pos.y = first.y; pos.y < high.y; ++pos.y) {
+                        for (pos.z = first.z; pos.z < high.z; ++pos.z) {
                             glm::vec3 v = CalcBestVertex(pos);
 
                             if (v.x != v.x) {
@@ -56,6 +66,8 @@ public:
         
         std::array<Mesh, Shards_> meshes;
         Mesh_.Clear();
+        Mesh_.Packing = PackedVertices_;
+        Mesh_.Origin = glm::vec3(first);
 
         auto addTriangle = [this](const glm::vec3& p0, const glm::vec3& p1, const glm::vec3& p2, bool swap, Mesh& mesh) {
             //mesh.Indices.emplace_back(mesh.Vertices.size());
@@ -68,9 +80,9 @@ public:
                     mesh.Normals.emplace_back(norm);
                     mesh.Normals.emplace_back(norm);
                 } else {
-                    mesh.Normals.emplace_back(VolumeProvider_(p0).Normal);
-                    mesh.Normals.emplace_back(VolumeProvider_(p1).Normal);
-                    mesh.Normals.emplace_back(VolumeProvider_(p2).Normal);
+                    mesh.Normals.emplace_back(Field_.Normal(p0));
+                    mesh.Normals.emplace_back(Field_.Normal(p1));
+                    mesh.Normals.emplace_back(Field_.Normal(p2));
                 }
 
                 mesh.Vertices.emplace_back(p0);
@@ -84,9 +96,9 @@ public:
                     mesh.Normals.emplace_back(norm);
                     mesh.Normals.emplace_back(norm);
                 } else {
-                    mesh.Normals.emplace_back(VolumeProvider_(p2).Normal);
-                    mesh.Normals.emplace_back(VolumeProvider_(p1).Normal);
-                    mesh.Normals.emplace_back(VolumeProvider_(p0).Normal);
+                    mesh.Normals.emplace_back(Field_.Normal(p2));
+                    mesh.Normals.emplace_back(Field_.Normal(p1));
+                    mesh.Normals.emplace_back(Field_.Normal(p0));
                 }
                 mesh.Vertices.emplace_back(p2);
                 mesh.Vertices.emplace_back(p1);
@@ -101,9 +113,10 @@ public:
                 for (pos.x = low.x + i; pos.x < high.x; pos.x += Shards_) {
                     for (pos.y = low.y; pos.y < high.y; ++pos.y) {
                         for (pos.z = low.z; pos.z < high.z; ++pos.z) {
-                            if (pos.x > low.x && pos.y > low.y) {
-                                bool s1 = std::signbit(VolumeProvider_(glm::vec3(pos.x, pos.y, pos.z + 0)).Value);
-                                bool s2 = std::signbit(VolumeProvider_(glm::vec3(pos.x, pos.y, pos.z + 1)).Value);
+                            // Edges along z, y and x from pos, each quad joins the four cells around its edge.
+                            {
+                                bool s1 = std::signbit(Field_.Value(glm::ivec3(pos.x, pos.y, pos.z + 0)));
+                                bool s2 = std::signbit(Field_.Value(glm::ivec3(pos.x, pos.y, pos.z + 1)));
                                 if (s1 != s2) {
                                     addTriangle(
                                         GetFromMapping(glm::ivec3(pos.x - 1, pos.y - 1, pos.z)),
@@ -118,9 +131,9 @@ public:
                                         s2, meshes[i]);
                                 }
                             }
-                            if (pos.x > low.x && pos.z > low.z) {
-                                bool s1 = std::signbit(VolumeProvider_(glm::vec3(pos.x, pos.y + 0, pos.z)).Value);
-                                bool s2 = std::signbit(VolumeProvider_(glm::vec3(pos.x, pos.y + 1, pos.z)).Value);
+                            {
+                                bool s1 = std::signbit(Field_.Value(glm::ivec3(pos.x, pos.y + 0, pos.z)));
+                                bool s2 = std::signbit(Field_.Value(glm::ivec3(pos.x, pos.y + 1, pos.z)));
                                 if (s1 != s2) {
                                     addTriangle(
                                         GetFromMapping(glm::ivec3(pos.x - 1, pos.y, pos.z - 1)),
@@ -135,9 +148,9 @@ public:
                                         s1, meshes[i]);
                                 }
                             }
-                            if (pos.y > low.y && pos.z > low.z) {
-                                bool s1 = std::signbit(VolumeProvider_(glm::vec3(pos.x + 0, pos.y, pos.z)).Value);
-                                bool s2 = std::signbit(VolumeProvider_(glm::vec3(pos.x + 1, pos.y, pos.z)).Value);
+                            {
+                                bool s1 = std::signbit(Field_.Value(glm::ivec3(pos.x + 0, pos.y, pos.z)));
+                                bool s2 = std::signbit(Field_.Value(glm::ivec3(pos.x + 1, pos.y, pos.z)));
                                 if (s1 != s2) {
                                     addTriangle(
                                         GetFromMapping(glm::ivec3(pos.x, pos.y - 1, pos.z - 1)),
@@ -172,15 +185,16 @@ private:
     glm::vec3 CalcBestVertex(const glm::vec3& pos) {
         //return pos + glm::vec3(0.5);
 
+        // 0 and -0 have different sign bits but no distance between them.
         auto adapt = [](float v0, float v1) {
-            return (0.0f - v0) / (v1 - v0);
+            return v0 == v1 ? 0.0f : (0.0f - v0) / (v1 - v0);
         };
 
         glm::mat2 v[2];
         for (size_t dx : { 0, 1 }) {
             for (size_t dy : { 0, 1 }) {
                 for (size_t dz : { 0, 1 }) {
-                    v[dx][dy][dz] = VolumeProvider_(glm::vec3(pos.x + dx, pos.y + dy, pos.z + dz)).Value;
+                    v[dx][dy][dz] = Field_.Value(glm::ivec3(pos.x + dx, pos.y + dy, pos.z + dz));
                 }
             }
         }
@@ -216,7 +230,7 @@ private:
         glm::vec3 c;
         float i = 0;
         for (auto& vv : changes) {
-            normals.emplace_back(VolumeProvider_(vv).Normal);
+            normals.emplace_back(Field_.Normal(vv));
             c += vv;
             ++i;
         }
@@ -245,12 +259,20 @@ private:
         HardNormals_ = flag;
     }
 
-    std::function<Point(const glm::vec3& pos)> GetVolumeProvider() const override {
+    bool GetPackedVertices() const override {
+        return PackedVertices_;
+    }
+
+    void SetPackedVertices(bool flag) override {
+        PackedVertices_ = flag;
+    }
+
+    std::shared_ptr<const IVolumeProvider> GetVolumeProvider() const override {
         return VolumeProvider_;
     }
 
-    void SetVolumeProvider(std::function<Point(const glm::vec3& pos)> volumeProvider) override {
-        VolumeProvider_ = volumeProvider;
+    void SetVolumeProvider(std::shared_ptr<const IVolumeProvider> volumeProvider) override {
+        VolumeProvider_ = std::move(volumeProvider);
     }
 
 private:
@@ -266,7 +288,9 @@ private:
     static constexpr size_t Shards_ = 16;
     Mesh Mesh_;
     bool HardNormals_ = false;
-    std::function<Point(const glm::vec3& pos)> VolumeProvider_;
+    bool PackedVertices_ = false;
+    std::shared_ptr<const IVolumeProvider> VolumeProvider_;
+    ScalarField Field_;
     std::array<std::unordered_map<glm::ivec3, glm::vec3>, Shards_> Mapping_;
     ThreadPool ThreadPool_;
     std::mutex Lock_;
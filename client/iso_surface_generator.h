@@ -1,38 +1,143 @@
 #pragma once
 
+#include <client/packed_vertex.h>
+
 #include <glm/glm.hpp>
 
-class IIsoSurfaceGenerator {
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// Source of the scalar field the generators mesh. Positive inside solid terrain, like
+// TerrainVolume, negative in air; the generators treat values below zero as outside.
+class IVolumeProvider {
 public:
     struct Point {
         float Value;
         glm::vec3 Normal;
     };
 
+    // Single sample, for positions off the lattice such as surface crossings.
+    virtual Point Sample(const glm::vec3& pos) const = 0;
+
+    // Samples size.x * size.y * size.z lattice points with unit spacing starting at origin,
+    // stored at Index(size, x, y, z). Normals are only filled when not null. Providers
+    // override this with kernels that share work between neighbouring points.
+    virtual void SampleBlock(const glm::ivec3& origin, const glm::ivec3& size, float* values, glm::vec3* normals) const {
+        for (int x = 0; x < size.x; ++x) {
+            for (int y = 0; y < size.y; ++y) {
+                for (int z = 0; z < size.z; ++z) {
+                    Point point = Sample(glm::vec3(origin + glm::ivec3(x, y, z)));
+                    values[Index(size, x, y, z)] = point.Value;
+                    if (normals) {
+                        normals[Index(size, x, y, z)] = point.Normal;
+                    }
+                }
+            }
+        }
+    }
+
+    static size_t Index(const glm::ivec3& size, int x, int y, int z) {
+        return ((size_t)x * size.y + y) * size.z + z;
+    }
+
+    virtual ~IVolumeProvider() = default;
+};
+
+// Adapts a per-point function, every sample is an indirect call.
+class FunctionVolumeProvider : public IVolumeProvider {
+public:
+    explicit FunctionVolumeProvider(std::function<Point(const glm::vec3& pos)> function)
+        : Function_(std::move(function))
+    {}
+
+    Point Sample(const glm::vec3& pos) const override {
+        return Function_(pos);
+    }
+
+private:
+    std::function<Point(const glm::vec3& pos)> Function_;
+};
+
+// Counts the points a generator asks another provider for, block samples included,
+// to check how often each lattice point is sampled. Safe to share between workers.
+class CountingVolumeProvider : public IVolumeProvider {
+public:
+    explicit CountingVolumeProvider(std::shared_ptr<const IVolumeProvider> provider)
+        : Provider_(std::move(provider))
+    {}
+
+    Point Sample(const glm::vec3& pos) const override {
+        Samples_.fetch_add(1, std::memory_order_relaxed);
+        return Provider_->Sample(pos);
+    }
+
+    void SampleBlock(const glm::ivec3& origin, const glm::ivec3& size, float* values, glm::vec3* normals) const override {
+        Samples_.fetch_add((uint64_t)size.x * size.y * size.z, std::memory_order_relaxed);
+        Provider_->SampleBlock(origin, size, values, normals);
+    }
+
+    uint64_t GetSamples() const {
+        return Samples_.load(std::memory_order_relaxed);
+    }
+
+    void Reset() {
+        Samples_.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    std::shared_ptr<const IVolumeProvider> Provider_;
+    mutable std::atomic<uint64_t> Samples_ = 0;
+};
+
+class IIsoSurfaceGenerator {
+public:
+    using Point = IVolumeProvider::Point;
+
     struct Mesh {
         std::vector<glm::vec3> Vertices;
         std::vector<glm::vec3> Normals;
+        // Filled instead of Vertices and Normals when packing, positions relative to Origin.
+        std::vector<PackedVertex> Packed;
         std::vector<unsigned int> Indices;
         size_t Count = 0;
+        glm::vec3 Origin = glm::vec3(0.0f);
+        bool Packing = false;
 
+        // Other's vertices are packed on the way in when this mesh is packing.
         void Merge(Mesh& other) {
+            const size_t offset = GetVertexCount();
             if (!other.Indices.empty()) {
                 Indices.reserve(Indices.size() + other.Indices.size());
                 for (unsigned int index : other.Indices) {
-                    Indices.emplace_back(index + Vertices.size());
+                    Indices.emplace_back(index + offset);
                 }
             }
 
-            Vertices.insert(Vertices.end(), other.Vertices.begin(), other.Vertices.end());
-            Normals.insert(Normals.end(), other.Normals.begin(), other.Normals.end());
+            if (Packing) {
+                Packed.reserve(Packed.size() + other.Vertices.size());
+                for (size_t i = 0; i < other.Vertices.size(); ++i) {
+                    Packed.emplace_back(other.Vertices[i], other.Normals[i], Origin);
+                }
+            } else {
+                Vertices.insert(Vertices.end(), other.Vertices.begin(), other.Vertices.end());
+                Normals.insert(Normals.end(), other.Normals.begin(), other.Normals.end());
+            }
 
             Count += other.Count;
         }
 
+        size_t GetVertexCount() const {
+            return Vertices.size() + Packed.size();
+        }
+
         void Clear() {
             Count = 0;
             Vertices.clear();
             Normals.clear();
+            Packed.clear();
             Indices.clear();
         }
     };
@@ -42,8 +147,16 @@ public:
     virtual bool GetHardNormals() const = 0;
     virtual void SetHardNormals(bool flag) = 0;
 
-    virtual std::function<Point(const glm::vec3& pos)> GetVolumeProvider() const = 0;
-    virtual void SetVolumeProvider(std::function<Point(const glm::vec3& pos)> volumeProvider) = 0;
+    // Packed meshes only fill Mesh::Packed, relative to Mesh::Origin.
+    virtual bool GetPackedVertices() const = 0;
+    virtual void SetPackedVertices(bool flag) = 0;
+
+    virtual std::shared_ptr<const IVolumeProvider> GetVolumeProvider() const = 0;
+    virtual void SetVolumeProvider(std::shared_ptr<const IVolumeProvider> volumeProvider) = 0;
+
+    void SetVolumeFunction(std::function<Point(const glm::vec3& pos)> function) {
+        SetVolumeProvider(std::make_shared<FunctionVolumeProvider>(std::move(function)));
+    }
 
     virtual ~IIsoSurfaceGenerator() = default;
 };
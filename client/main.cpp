@@ -1,8 +1,10 @@
 #include <client/shader_program.h>
+#include <client/chunk_manager.h>
 #include <client/dual_contour.h>
 #include <client/marching_cubes.h>
-#include <client/simplex.h>
 #include <client/iso_surface_generator.h>
+#include <client/terrain_volume_provider.h>
+#include <core/terrain.h>
 
 #include <gl/glew.h>
 #include <glm/glm.hpp>
@@ -13,14 +15,67 @@
 
 #include <iostream>
 #include <chrono>
+#include <cstddef>
 #include <memory>
 #include <tuple>
+#include <unordered_map>
 
 
 void window_size_callback(GLFWwindow* window, int x, int y) {
     glViewport(0, 0, x, y);
 }
 
+// Buffers of one chunk mesh: vertices, normals and indices. Packed meshes keep their
+// interleaved vertices in the first buffer and leave the second one empty.
+struct GpuChunk {
+    GLuint Buffers[3] = {};
+    GLsizei Count = 0;
+    bool Indexed = false;
+    bool Packed = false;
+    glm::vec3 Origin = glm::vec3(0.0f);
+    uint64_t Version = 0;
+};
+
+// Uploads the chunks remeshed since the last call and frees the ones the manager dropped.
+void sync_chunks(const ChunkManager& manager, std::unordered_map<glm::ivec3, GpuChunk>& gpuChunks) {
+    for (auto it = gpuChunks.begin(); it != gpuChunks.end();) {
+        if (!manager.GetChunks().count(it->first)) {
+            glDeleteBuffers(3, it->second.Buffers);
+            it = gpuChunks.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    for (const auto& [coord, chunk] : manager.GetChunks()) {
+        auto [it, inserted] = gpuChunks.try_emplace(coord);
+        GpuChunk& gpuChunk = it->second;
+        if (inserted) {
+            glGenBuffers(3, gpuChunk.Buffers);
+        } else if (gpuChunk.Version == chunk.Version) {
+            continue;
+        }
+
+        const IIsoSurfaceGenerator::Mesh& mesh = chunk.Mesh;
+        if (mesh.Packing) {
+            glBindBuffer(GL_ARRAY_BUFFER, gpuChunk.Buffers[0]);
+            glBufferData(GL_ARRAY_BUFFER, sizeof(PackedVertex) * mesh.Packed.size(), mesh.Packed.data(), GL_STATIC_DRAW);
+        } else {
+            glBindBuffer(GL_ARRAY_BUFFER, gpuChunk.Buffers[0]);
+            glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * mesh.Vertices.size(), mesh.Vertices.data(), GL_STATIC_DRAW);
+            glBindBuffer(GL_ARRAY_BUFFER, gpuChunk.Buffers[1]);
+            glBufferData(GL_ARRAY_BUFFER, sizeof(glm::vec3) * mesh.Normals.size(), mesh.Normals.data(), GL_STATIC_DRAW);
+        }
+        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gpuChunk.Buffers[2]);
+        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * mesh.Indices.size(), mesh.Indices.data(), GL_STATIC_DRAW);
+        gpuChunk.Count = mesh.Count;
+        gpuChunk.Indexed = !mesh.Indices.empty();
+        gpuChunk.Packed = mesh.Packing;
+        gpuChunk.Origin = mesh.Origin;
+        gpuChunk.Version = chunk.Version;
+    }
+}
+
 
 int main() {
     if(!glfwInit()) {
@@ -112,8 +167,8 @@ void main() {
 	outColor = vec4(p.xyz, 1);
 })");
 
-    GLuint vboIds[4];
-    glGenBuffers(4, vboIds);
+    GLuint axisVboId;
+    glGenBuffers(1, &axisVboId);
     shaderProgram.Bind();
 
     glm::mat4 projection = glm::perspective(glm::radians(70.0f), 1024.0f / 768.0f, 0.01f, 100.0f);
@@ -128,38 +183,14 @@ void main() {
     bool pppp = false;
     bool r = false;
 
-    auto normalFromFunction = [](std::function<float(float, float, float)> f, float d = 0.01) {
-        return [f, d](float x, float y, float z) {
-            return -glm::normalize(glm::vec3(
-                (f(x + d, y, z) - f(x - d, y, z)),
-                (f(x, y + d, z) - f(x, y - d, z)),
-                (f(x, y, z + d) - f(x, y, z - d))) / 2.0f / d);
-        };
-    };
-
-
-    auto f = [&elapsed](float x, float y, float z) {
-        float factor = std::max(0.0f, std::max(std::abs(x) - 10, std::max(std::abs(y) - 10, std::abs(z) - 10))) / 7.0f;
-        factor *= factor;
-        return
-            Simplex::noise(glm::vec4(x / 20, 0, z / 20, elapsed / 3.0f)) * 0.7f +
-            Simplex::noise(glm::vec4(x / 10, 0, z / 10, elapsed / 3.0f)) * 0.3f +
-            //Simplex::noise(glm::vec4(x / 4, 0, z / 4, elapsed / 3.0f)) * 0.0f +
-            - y / 10.0f;
-        //return Simplex::noise(glm::vec4(x / 10, 0, z / 10, elapsed / 3.0f)) - y / 10.0f;// - factor;
-    };
-
-    auto nrm = normalFromFunction(f, 0.01);
-    auto ff = [&f, &nrm](const glm::vec3& p) {
-        return DualContour::Point {
-            (float)f(p.x, p.y, p.z),
-            nrm(p.x, p.y, p.z)
-        };
-    };
+    TerrainVolume volume;
+    auto provider = std::make_shared<TerrainVolumeProvider>(volume);
 
     std::array<std::shared_ptr<IIsoSurfaceGenerator>, 2> gens = { std::shared_ptr<IIsoSurfaceGenerator>(new MarchingCubes), std::shared_ptr<IIsoSurfaceGenerator>(new DualContour) };
-    gens[0]->SetVolumeProvider(ff);
-    gens[1]->SetVolumeProvider(ff);
+    gens[0]->SetVolumeProvider(provider);
+    gens[1]->SetVolumeProvider(provider);
+    gens[0]->SetPackedVertices(true);
+    gens[1]->SetPackedVertices(true);
 
     const float axis[18] {
         0.0f, 0.0f, 0.0f, 100.0f, 0.0f, 0.0f,
@@ -167,15 +198,17 @@ void main() {
         0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 100.0f,
     };
 
-    glBindBuffer(GL_ARRAY_BUFFER, vboIds[3]);
+    glBindBuffer(GL_ARRAY_BUFFER, axisVboId);
     glBufferData(GL_ARRAY_BUFFER, sizeof(axis), axis, GL_STATIC_DRAW);
 
-    IIsoSurfaceGenerator::Mesh* mesh = &gens[0]->Generate(glm::ivec3(-3), glm::ivec3(3));
+    ChunkManager chunks(gens[0], ChunkManagerConfig());
+    std::unordered_map<glm::ivec3, GpuChunk> gpuChunks;
 
     do {
         float delta = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now() - start).count() / 1'000'000'000.0f;
         if (r) {
             elapsed += delta;
+            volume.SetTime(elapsed);
         }
         start = std::chrono::high_resolution_clock::now();
 
@@ -183,54 +216,62 @@ void main() {
         glEnableVertexAttribArray(0);
         glEnableVertexAttribArray(1);
 
+        // The animated field changes everywhere, chunks take turns within the per frame budget.
         if (r) {
-            mesh = &gens[0]->Generate(glm::ivec3(-3), glm::ivec3(3));
+            chunks.MarkAllDirty();
         }
-
-        glBindBuffer(GL_ARRAY_BUFFER, vboIds[0]);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 3 * mesh->Vertices.size(), glm::value_ptr(mesh->Vertices[0]), GL_DYNAMIC_DRAW);
-        glBindBuffer(GL_ARRAY_BUFFER, vboIds[1]);
-        glBufferData(GL_ARRAY_BUFFER, sizeof(float) * 3 * mesh->Normals.size(), glm::value_ptr(mesh->Normals[0]), GL_DYNAMIC_DRAW);
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vboIds[2]);
-        glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(unsigned int) * mesh->Indices.size(), mesh->Indices.data(), GL_DYNAMIC_DRAW);
-
-        glBindBuffer(GL_ARRAY_BUFFER, vboIds[0]);
-        glVertexAttribPointer(
-            0,                  // attribute 0. No particular reason for 0, but must match the layout in the shader.
-            3,                  // size
-            GL_FLOAT,           // type
-            GL_FALSE,           // normalized?
-            0,                  // stride
-            nullptr             // array buffer offset
-        );
-
-        glBindBuffer(GL_ARRAY_BUFFER, vboIds[1]);
-        glVertexAttribPointer(
-            1,                  // attribute 0. No particular reason for 0, but must match the layout in the shader.
-            3,                  // size
-            GL_FLOAT,           // type
-            GL_FALSE,           // normalized?
-            0,                  // stride
-            nullptr             // array buffer offset
-        );
-
-        glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, vboIds[2]);
+        chunks.Update(glm::vec3(0.0f));
+        sync_chunks(chunks, gpuChunks);
 
         view = glm::lookAt(glm::vec3(std::sin(elapsed / 10) * 25, 15, std::cos(elapsed / 10) * 25), glm::vec3(0, 0, 0), glm::vec3(0, 1, 0));
         //model *= glm::rotate(delta, glm::vec3(1, 0, 0));
 
         shaderProgram.Bind();
-        glUniformMatrix4fv(glGetUniformLocation(shaderProgram.ProgramId_, "mvp"), 1, GL_FALSE, glm::value_ptr(projection * view * model));
         glUniformMatrix4fv(glGetUniformLocation(shaderProgram.ProgramId_, "nmat"), 1, GL_FALSE, glm::value_ptr(glm::transpose(glm::inverse(model))));
 
-        if (mesh->Indices.empty()) {
-            glDrawArrays(GL_TRIANGLES, 0, mesh->Count);
-        } else {
-            glDrawElements(GL_TRIANGLES, mesh->Count, GL_UNSIGNED_INT, nullptr);
+        for (const auto& [coord, gpuChunk] : gpuChunks) {
+            if (gpuChunk.Packed) {
+                // Fixed point positions relative to the chunk origin are scaled back by the model matrix.
+                glm::mat4 chunkModel = model * glm::translate(gpuChunk.Origin) * glm::scale(glm::vec3(1.0f / PackedVertex::PositionScale));
+                glUniformMatrix4fv(glGetUniformLocation(shaderProgram.ProgramId_, "mvp"), 1, GL_FALSE, glm::value_ptr(projection * view * chunkModel));
+
+                glBindBuffer(GL_ARRAY_BUFFER, gpuChunk.Buffers[0]);
+                glVertexAttribPointer(0, 3, GL_UNSIGNED_SHORT, GL_FALSE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Position));
+                glVertexAttribPointer(1, 4, GL_INT_2_10_10_10_REV, GL_TRUE, sizeof(PackedVertex), (void*)offsetof(PackedVertex, Normal));
+            } else {
+                glUniformMatrix4fv(glGetUniformLocation(shaderProgram.ProgramId_, "mvp"), 1, GL_FALSE, glm::value_ptr(projection * view * model));
+
+                glBindBuffer(GL_ARRAY_BUFFER, gpuChunk.Buffers[0]);
+                glVertexAttribPointer(
+                    0,                  // attribute 0. No particular reason for 0, but must match the layout in the shader.
+                    3,                  // size
+                    GL_FLOAT,           // type
+                    GL_FALSE,           // normalized?
+                    0,                  // stride
+                    nullptr             // array buffer offset
+                );
+
+                glBindBuffer(GL_ARRAY_BUFFER, gpuChunk.Buffers[1]);
+                glVertexAttribPointer(
+                    1,                  // attribute 0. No particular reason for 0, but must match the layout in the shader.
+                    3,                  // size
+                    GL_FLOAT,           // type
+                    GL_FALSE,           // normalized?
+                    0,                  // stride
+                    nullptr             // array buffer offset
+                );
+            }
+
+            if (gpuChunk.Indexed) {
+                glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, gpuChunk.Buffers[2]);
+                glDrawElements(GL_TRIANGLES, gpuChunk.Count, GL_UNSIGNED_INT, nullptr);
+            } else {
+                glDrawArrays(GL_TRIANGLES, 0, gpuChunk.Count);
+            }
         }
 
 
-        glBindBuffer(GL_ARRAY_BUFFER, vboIds[3]);
+        glBindBuffer(GL_ARRAY_BUFFER, axisVboId);
         glVertexAttribPointer(
             0,
             3,
@@ -262,6 +303,7 @@ void main() {
         if (glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS) {
             if (!pp) {
                 gens[0]->SetHardNormals(!gens[0]->GetHardNormals());
+                chunks.MarkAllDirty();
             }
         }
         pp = glfwGetKey(window, GLFW_KEY_H) == GLFW_PRESS;
@@ -271,6 +313,7 @@ void main() {
             if (!ppp) {
                 std::swap(gens[0], gens[1]);
                 gens[0]->SetHardNormals(gens[1]->GetHardNormals());
+                chunks.SetGenerator(gens[0]);
             }
         }
         ppp = glfwGetKey(window, GLFW_KEY_A) == GLFW_PRESS;
@@ -284,7 +327,10 @@ void main() {
         //std::cout << 1.0f / delta << std::endl;
     } while (glfwGetKey(window, GLFW_KEY_ESCAPE) != GLFW_PRESS && glfwWindowShouldClose(window) == 0);
 
-    glDeleteBuffers(4, vboIds);
+    for (auto& [coord, gpuChunk] : gpuChunks) {
+        glDeleteBuffers(3, gpuChunk.Buffers);
+    }
+    glDeleteBuffers(1, &axisVboId);
     glDeleteVertexArrays(1, &vaoId);
 
     glfwTerminate();
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <client/iso_surface_generator.h>
+#include <client/scalar_field.h>
 
 #include <glm/glm.hpp>
 
@@ -289,6 +290,25 @@ const size_t edgeToVertex[12][2] = {
     { 3, 7 },
 };
 
+// The same edges as lattice edges: the corner they start at and the axis they run along.
+const struct {
+    glm::ivec3 Base;
+    int Axis;
+} edgeToLattice[12] = {
+    { glm::ivec3(0, 0, 0), 0 },
+    { glm::ivec3(1, 0, 0), 2 },
+    { glm::ivec3(0, 0, 1), 0 },
+    { glm::ivec3(0, 0, 0), 2 },
+    { glm::ivec3(0, 1, 0), 0 },
+    { glm::ivec3(1, 1, 0), 2 },
+    { glm::ivec3(0, 1, 1), 0 },
+    { glm::ivec3(0, 1, 0), 2 },
+    { glm::ivec3(0, 0, 0), 1 },
+    { glm::ivec3(1, 0, 0), 1 },
+    { glm::ivec3(1, 0, 1), 1 },
+    { glm::ivec3(0, 0, 1), 1 },
+};
+
 class MarchingCubes : public IIsoSurfaceGenerator {
 public:
     MarchingCubes()
@@ -297,10 +317,18 @@ public:
 
     Mesh& Generate(const glm::ivec3& low, const glm::ivec3& high) override {
         Mesh_.Clear();
+        Mesh_.Packing = PackedVertices_;
+        Mesh_.Origin = glm::vec3(low);
         std::array<Mesh, Shards_> meshes = {};
         std::array<std::future<void>, Shards_> results = {};
 
-        glm::ivec3 pos;
+        // Cells reach one lattice point past high.
+        Field_.Sample(*VolumeProvider_, low, high, !HardNormals_, ThreadPool_, Shards_);
+
+        // Flat shading needs its own vertices per triangle.
+        if (Indexed_ && !HardNormals_) {
+            return GenerateIndexed(low, high);
+        }
 
         for (size_t k = 0; k < Shards_; ++k) {
             results[k] = ThreadPool_.enqueue([k, this, &low, &high, &meshes]() {
@@ -308,9 +336,11 @@ public:
                 for (pos.x = low.x + k; pos.x < high.x; pos.x += Shards_) {
                     for (pos.y = low.y; pos.y < high.y; ++pos.y) {
                         for (pos.z = low.z; pos.z < high.z; ++pos.z) {
+                            std::array<float, 8> values;
                             size_t index = 0;
                             for (size_t i = 0; i < 8; ++i) {
-                                if (VolumeProvider_(pos + verts[i]).Value < 0.0f) {
+                                values[i] = Field_.Value(pos + verts[i]);
+                                if (values[i] < 0.0f) {
                                     index |= (1 << i);
                                 }
                             }
@@ -320,6 +350,7 @@ public:
                             }
 
                             std::array<glm::vec3, 12> vs = {};
+                            std::array<glm::vec3, 12> ns = {};
                             std::array<bool, 12> flags = {};
 
                             for (size_t i = 0; triTable[index][i] != -1; i += 3) {
@@ -329,11 +360,16 @@ public:
                                 meshes[k].Count += 3;
 
                                 for (size_t j = 0; j < 3; ++j) {
-                                    if (!flags[triTable[index][i + j]]) {
-                                        glm::vec3 p1 = pos + verts[edgeToVertex[triTable[index][i + j]][0]];
-                                        glm::vec3 p2 = pos + verts[edgeToVertex[triTable[index][i + j]][1]];
-                                        vs[triTable[index][i + j]] = Lerp(p1, p2, VolumeProvider_(p1).Value, VolumeProvider_(p2).Value);
-                                        flags[triTable[index][i + j]] = true;
+                                    const int edge = triTable[index][i + j];
+                                    if (!flags[edge]) {
+                                        const size_t v1 = edgeToVertex[edge][0];
+                                        const size_t v2 = edgeToVertex[edge][1];
+                                        const float mu = Crossing(values[v1], values[v2]);
+                                        vs[edge] = glm::vec3(pos + verts[v1]) + glm::vec3(verts[v2] - verts[v1]) * mu;
+                                        if (!HardNormals_) {
+                                            ns[edge] = glm::normalize(glm::mix(Field_.Normal(pos + verts[v1]), Field_.Normal(pos + verts[v2]), mu));
+                                        }
+                                        flags[edge] = true;
                                     }
                                 }
 
@@ -350,9 +386,9 @@ public:
                                     meshes[k].Normals.emplace_back(norm);
                                     meshes[k].Normals.emplace_back(norm);
                                 } else {
-                                    meshes[k].Normals.emplace_back(VolumeProvider_(p2).Normal);
-                                    meshes[k].Normals.emplace_back(VolumeProvider_(p1).Normal);
-                                    meshes[k].Normals.emplace_back(VolumeProvider_(p0).Normal);
+                                    meshes[k].Normals.emplace_back(ns[triTable[index][i + 2]]);
+                                    meshes[k].Normals.emplace_back(ns[triTable[index][i + 1]]);
+                                    meshes[k].Normals.emplace_back(ns[triTable[index][i]]);
                                 }
                             }
                         }
@@ -371,12 +407,12 @@ public:
         return Mesh_;
     }
 
-    std::function<Point(const glm::vec3& pos)> GetVolumeProvider() const override {
+    std::shared_ptr<const IVolumeProvider> GetVolumeProvider() const override {
         return VolumeProvider_;
     }
 
-    void SetVolumeProvider(std::function<Point(const glm::vec3& pos)> volumeProvider) override {
-        VolumeProvider_ = volumeProvider;
+    void SetVolumeProvider(std::shared_ptr<const IVolumeProvider> volumeProvider) override {
+        VolumeProvider_ = std::move(volumeProvider);
     }
 
     bool GetHardNormals() const override {
@@ -387,26 +423,151 @@ public:
         HardNormals_ = flag;
     }
 
+    bool GetPackedVertices() const override {
+        return PackedVertices_;
+    }
+
+    void SetPackedVertices(bool flag) override {
+        PackedVertices_ = flag;
+    }
+
+    // Indexed meshes share one vertex per active lattice edge between all cells around it,
+    // otherwise every triangle gets three vertices of its own. Hard normals are never indexed.
+    bool GetIndexed() const {
+        return Indexed_;
+    }
+
+    void SetIndexed(bool flag) {
+        Indexed_ = flag;
+    }
+
 private:
-    glm::vec3 Lerp(const glm::vec3& p1, const glm::vec3& p2, float v1, float v2) {
+    // Vertices and edge table of one x slice of the lattice, the edge table maps every
+    // edge starting in the slice to its vertex, local to the slice.
+    struct EdgeSlice {
+        Mesh Part;
+        std::vector<unsigned int> Edges;
+        std::vector<unsigned int> Triangles;
+        unsigned int Offset = 0;
+    };
+
+    Mesh& GenerateIndexed(const glm::ivec3& low, const glm::ivec3& high) {
+        const glm::ivec3 size = high - low + 1;
+        Slices_.resize(size.x);
+        std::array<std::future<void>, Shards_> results = {};
+
+        // Each slice places the vertices of the active edges that start in it.
+        for (size_t k = 0; k < Shards_; ++k) {
+            results[k] = ThreadPool_.enqueue([k, this, &low, &high, &size]() {
+                for (int x = k; x < size.x; x += Shards_) {
+                    EdgeSlice& slice = Slices_[x];
+                    slice.Part.Clear();
+                    slice.Triangles.clear();
+                    slice.Edges.assign((size_t)size.y * size.z * 3, 0);
+
+                    glm::ivec3 pos(low.x + x, 0, 0);
+                    for (pos.y = low.y; pos.y <= high.y; ++pos.y) {
+                        for (pos.z = low.z; pos.z <= high.z; ++pos.z) {
+                            const float value = Field_.Value(pos);
+                            for (int axis = 0; axis < 3; ++axis) {
+                                glm::ivec3 next = pos;
+                                ++next[axis];
+                                if (next[axis] > high[axis] || (value < 0.0f) == (Field_.Value(next) < 0.0f)) {
+                                    continue;
+                                }
+
+                                const float mu = Crossing(value, Field_.Value(next));
+                                glm::vec3 vertex(pos);
+                                vertex[axis] += mu;
+                                slice.Edges[EdgeIndex(size, pos.y - low.y, pos.z - low.z, axis)] = slice.Part.Vertices.size();
+                                slice.Part.Vertices.emplace_back(vertex);
+                                slice.Part.Normals.emplace_back(glm::normalize(glm::mix(Field_.Normal(pos), Field_.Normal(next), mu)));
+                            }
+                        }
+                    }
+                }
+            });
+        }
+
+        for (size_t i = 0; i < Shards_; ++i) {
+            results[i].get();
+        }
+
+        Mesh_.Clear();
+        Mesh_.Packing = PackedVertices_;
+        Mesh_.Origin = glm::vec3(low);
+        for (EdgeSlice& slice : Slices_) {
+            slice.Offset = Mesh_.GetVertexCount();
+            Mesh_.Merge(slice.Part);
+        }
+
+        // Cells only look their vertices up in the two slices they span.
+        for (size_t k = 0; k < Shards_; ++k) {
+            results[k] = ThreadPool_.enqueue([k, this, &low, &size]() {
+                for (int x = k; x + 1 < size.x; x += Shards_) {
+                    std::vector<unsigned int>& triangles = Slices_[x].Triangles;
+                    for (int y = 0; y + 1 < size.y; ++y) {
+                        for (int z = 0; z + 1 < size.z; ++z) {
+                            const glm::ivec3 pos = low + glm::ivec3(x, y, z);
+                            size_t index = 0;
+                            for (size_t i = 0; i < 8; ++i) {
+                                if (Field_.Value(pos + verts[i]) < 0.0f) {
+                                    index |= (1 << i);
+                                }
+                            }
+
+                            for (size_t i = 0; triTable[index][i] != -1; i += 3) {
+                                for (size_t j : { 2, 1, 0 }) {
+                                    const auto& edge = edgeToLattice[triTable[index][i + j]];
+                                    const EdgeSlice& slice = Slices_[x + edge.Base.x];
+                                    triangles.emplace_back(slice.Offset + slice.Edges[EdgeIndex(size, y + edge.Base.y, z + edge.Base.z, edge.Axis)]);
+                                }
+                            }
+                        }
+                    }
+                }
+            });
+        }
+
+        for (size_t i = 0; i < Shards_; ++i) {
+            results[i].get();
+        }
+
+        for (const EdgeSlice& slice : Slices_) {
+            Mesh_.Indices.insert(Mesh_.Indices.end(), slice.Triangles.begin(), slice.Triangles.end());
+        }
+        Mesh_.Count = Mesh_.Indices.size();
+
+        return Mesh_;
+    }
+
+    static size_t EdgeIndex(const glm::ivec3& size, int y, int z, int axis) {
+        return ((size_t)y * size.z + z) * 3 + axis;
+    }
+
+    // Position of the zero crossing between two corners, 0 at the first and 1 at the second.
+    static float Crossing(float v1, float v2) {
         if (std::abs(v1) < 0.00001) {
-            return p1;
+            return 0.0f;
         }
         if (std::abs(v2) < 0.00001) {
-            return p2;
+            return 1.0f;
         }
         if (std::abs(v1 - v2) < 0.00001) {
-            return p1;
+            return 0.0f;
         }
-        float mu = -v1 / (v2 - v1);
-        return (p2 - p1) * mu + p1;
+        return -v1 / (v2 - v1);
     }
 
 private:
     static constexpr size_t Shards_ = 16;
     Mesh Mesh_;
-    std::function<Point(const glm::vec3& pos)> VolumeProvider_;
+    std::shared_ptr<const IVolumeProvider> VolumeProvider_;
     bool HardNormals_ = false;
+    bool PackedVertices_ = false;
+    bool Indexed_ = true;
+    ScalarField Field_;
+    std::vector<EdgeSlice> Slices_;
     ThreadPool ThreadPool_;
     std::mutex Lock_;
 };
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+// Interleaved mesh vertex, 12 bytes instead of the 24 of separate float positions and normals.
+// Positions are unsigned 8.8 fixed point relative to the mesh origin, which covers chunks of
+// up to 255 cells with 1/256 precision. Normals are signed 10:10:10:2, the layout of
+// GL_INT_2_10_10_10_REV, so shaders read both without decoding.
+struct PackedVertex {
+    static constexpr float PositionScale = 256.0f;
+
+    uint16_t Position[3];
+    uint16_t Padding = 0;
+    uint32_t Normal;
+
+    PackedVertex() = default;
+
+    PackedVertex(const glm::vec3& position, const glm::vec3& normal, const glm::vec3& origin) {
+        const glm::vec3 local = glm::round((position - origin) * PositionScale);
+        for (int i = 0; i < 3; ++i) {
+            Position[i] = (uint16_t)std::clamp(local[i], 0.0f, 65535.0f);
+        }
+        Normal = PackNormal(normal);
+    }
+
+    glm::vec3 GetPosition(const glm::vec3& origin) const {
+        return origin + glm::vec3(Position[0], Position[1], Position[2]) / PositionScale;
+    }
+
+    glm::vec3 GetNormal() const {
+        return UnpackNormal(Normal);
+    }
+
+    // Components in [-1, 1] are rounded to 10 bit signed integers, x in the low bits.
+    // Degenerate triangles have NaN normals, they are packed as zero.
+    static uint32_t PackNormal(const glm::vec3& normal) {
+        uint32_t packed = 0;
+        for (int i = 0; i < 3; ++i) {
+            const float component = std::isnan(normal[i]) ? 0.0f : std::clamp(normal[i], -1.0f, 1.0f);
+            const int value = (int)std::round(component * 511.0f);
+            packed |= ((uint32_t)value & 0x3ff) << (i * 10);
+        }
+        return packed;
+    }
+
+    static glm::vec3 UnpackNormal(uint32_t packed) {
+        glm::vec3 normal;
+        for (int i = 0; i < 3; ++i) {
+            // Sign extends the 10 bit field.
+            const int value = (int)(packed << (22 - i * 10)) >> 22;
+            normal[i] = std::max(value / 511.0f, -1.0f);
+        }
+        return normal;
+    }
+};
+
+static_assert(sizeof(PackedVertex) == 12);
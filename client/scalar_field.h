@@ -0,0 +1,111 @@
+#pragma once
+
+#include <client/iso_surface_generator.h>
+#include <core/thread_pool.h>
+
+#include <glm/glm.hpp>
+
+#include <algorithm>
+#include <future>
+#include <memory>
+#include <new>
+#include <vector>
+
+// Dense lattice of provider samples covering one Generate call. Every lattice point
+// is sampled exactly once through the provider's block kernel, generators classify
+// cells, place vertices and interpolate normals from the grid afterwards.
+class ScalarField {
+public:
+    // Samples the lattice points from low to high inclusive, one slab of x per worker.
+    // Normals are only sampled when requested.
+    void Sample(const IVolumeProvider& provider, const glm::ivec3& low, const glm::ivec3& high, bool normals, ThreadPool& pool, size_t slabs) {
+        Low_ = low;
+        Size_ = high - low + 1;
+        HasNormals_ = normals;
+        Reserve((size_t)Size_.x * Size_.y * Size_.z);
+
+        slabs = std::clamp<size_t>(slabs, 1, Size_.x);
+        const int width = (Size_.x + slabs - 1) / slabs;
+        std::vector<std::future<void>> results;
+        for (int x = 0; x < Size_.x; x += width) {
+            results.push_back(pool.enqueue([this, &provider, x, width]() {
+                const glm::ivec3 size(std::min(width, Size_.x - x), Size_.y, Size_.z);
+                const size_t offset = IVolumeProvider::Index(Size_, x, 0, 0);
+                provider.SampleBlock(Low_ + glm::ivec3(x, 0, 0), size, Values_.get() + offset, HasNormals_ ? Normals_.get() + offset : nullptr);
+            }));
+        }
+        for (std::future<void>& result : results) {
+            result.get();
+        }
+    }
+
+    float Value(const glm::ivec3& p) const {
+        return Values_[Index(p)];
+    }
+
+    const glm::vec3& Normal(const glm::ivec3& p) const {
+        return Normals_[Index(p)];
+    }
+
+    // Trilinear interpolation of the lattice normals, p must lie within the field.
+    glm::vec3 Normal(const glm::vec3& p) const {
+        const glm::vec3 local = p - glm::vec3(Low_);
+        const glm::ivec3 cell = glm::clamp(glm::ivec3(glm::floor(local)), glm::ivec3(0), Size_ - 2);
+        const glm::vec3 t = glm::clamp(local - glm::vec3(cell), 0.0f, 1.0f);
+        const glm::ivec3 base = Low_ + cell;
+
+        glm::vec3 result(0.0f);
+        for (int dx : { 0, 1 }) {
+            for (int dy : { 0, 1 }) {
+                for (int dz : { 0, 1 }) {
+                    const float weight = (dx ? t.x : 1.0f - t.x) * (dy ? t.y : 1.0f - t.y) * (dz ? t.z : 1.0f - t.z);
+                    result += Normal(base + glm::ivec3(dx, dy, dz)) * weight;
+                }
+            }
+        }
+        return glm::normalize(result);
+    }
+
+    bool HasNormals() const {
+        return HasNormals_;
+    }
+
+private:
+    struct AlignedDelete {
+        template <class T>
+        void operator()(T* data) const {
+            ::operator delete[](data, std::align_val_t(CacheLine_));
+        }
+    };
+
+    template <class T>
+    using AlignedArray = std::unique_ptr<T[], AlignedDelete>;
+
+    template <class T>
+    static AlignedArray<T> Allocate(size_t count) {
+        return AlignedArray<T>(static_cast<T*>(::operator new[](count * sizeof(T), std::align_val_t(CacheLine_))));
+    }
+
+    size_t Index(const glm::ivec3& p) const {
+        return IVolumeProvider::Index(Size_, p.x - Low_.x, p.y - Low_.y, p.z - Low_.z);
+    }
+
+    // Grids are kept between calls and only grow.
+    void Reserve(size_t count) {
+        if (count <= Capacity_) {
+            return;
+        }
+        Values_ = Allocate<float>(count);
+        Normals_ = Allocate<glm::vec3>(count);
+        Capacity_ = count;
+    }
+
+private:
+    static constexpr size_t CacheLine_ = 64;
+    glm::ivec3 Low_ = glm::ivec3(0);
+    glm::ivec3 Size_ = glm::ivec3(0);
+    AlignedArray<float> Values_;
+    AlignedArray<glm::vec3> Normals_;
+    size_t Capacity_ = 0;
+    bool HasNormals_ = false;
+};
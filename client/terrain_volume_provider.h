@@ -0,0 +1,23 @@
+#pragma once
+
+#include <client/iso_surface_generator.h>
+#include <core/terrain.h>
+
+// Terrain density field for the generators, blocks are sampled column by column.
+class TerrainVolumeProvider : public IVolumeProvider {
+public:
+    explicit TerrainVolumeProvider(const TerrainVolume& volume)
+        : Volume_(volume)
+    {}
+
+    Point Sample(const glm::vec3& pos) const override {
+        return Point { Volume_.Sample(pos), Volume_.Normal(pos) };
+    }
+
+    void SampleBlock(const glm::ivec3& origin, const glm::ivec3& size, float* values, glm::vec3* normals) const override {
+        Volume_.SampleBlock(origin, size, values, normals);
+    }
+
+private:
+    const TerrainVolume& Volume_;
+};
@@ -0,0 +1,116 @@
+#include <core/alloc_tracker.h>
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+thread_local AllocationStats stats;
+
+}
+
+bool AllocationStats::IsTracking() {
+#ifdef ALLOCATION_TRACKING
+    return true;
+#else
+    return false;
+#endif
+}
+
+AllocationStats AllocationStats::Current() {
+    return stats;
+}
+
+#ifdef ALLOCATION_TRACKING
+
+// Replaces the global allocation functions of every executable that references the
+// counters above, the linker pulls this translation unit in only then.
+
+namespace {
+
+void* allocate(size_t size, size_t alignment) {
+    ++stats.Allocations;
+    stats.Bytes += size;
+
+    size = size ? size : 1;
+    if (alignment <= alignof(std::max_align_t)) {
+        return malloc(size);
+    }
+    return aligned_alloc(alignment, (size + alignment - 1) / alignment * alignment);
+}
+
+void* allocate_or_throw(size_t size, size_t alignment) {
+    void* data = allocate(size, alignment);
+    if (!data) {
+        throw std::bad_alloc();
+    }
+    return data;
+}
+
+void deallocate(void* data) {
+    if (data) {
+        ++stats.Frees;
+        free(data);
+    }
+}
+
+}
+
+void* operator new(size_t size) {
+    return allocate_or_throw(size, 0);
+}
+
+void* operator new[](size_t size) {
+    return allocate_or_throw(size, 0);
+}
+
+void* operator new(size_t size, std::align_val_t alignment) {
+    return allocate_or_throw(size, (size_t)alignment);
+}
+
+void* operator new[](size_t size, std::align_val_t alignment) {
+    return allocate_or_throw(size, (size_t)alignment);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size, 0);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept {
+    return allocate(size, 0);
+}
+
+void operator delete(void* data) noexcept {
+    deallocate(data);
+}
+
+void operator delete[](void* data) noexcept {
+    deallocate(data);
+}
+
+void operator delete(void* data, size_t) noexcept {
+    deallocate(data);
+}
+
+void operator delete[](void* data, size_t) noexcept {
+    deallocate(data);
+}
+
+void operator delete(void* data, std::align_val_t) noexcept {
+    deallocate(data);
+}
+
+void operator delete[](void* data, std::align_val_t) noexcept {
+    deallocate(data);
+}
+
+void operator delete(void* data, size_t, std::align_val_t) noexcept {
+    deallocate(data);
+}
+
+void operator delete[](void* data, size_t, std::align_val_t) noexcept {
+    deallocate(data);
+}
+
+#endif
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+
+// Heap allocations made through operator new by the calling thread. Counted by
+// replacement operator new/delete compiled in with the ALLOCATION_TRACKING CMake
+// option; without it the counters stay zero. malloc calls, like ENet's, are not seen.
+struct AllocationStats {
+    uint64_t Allocations = 0;
+    uint64_t Frees = 0;
+    uint64_t Bytes = 0;
+
+    static bool IsTracking();
+    static AllocationStats Current();
+
+    AllocationStats operator-(const AllocationStats& other) const {
+        return AllocationStats { Allocations - other.Allocations, Frees - other.Frees, Bytes - other.Bytes };
+    }
+
+    AllocationStats& operator+=(const AllocationStats& other) {
+        Allocations += other.Allocations;
+        Frees += other.Frees;
+        Bytes += other.Bytes;
+        return *this;
+    }
+};
+
+// Allocations made by the calling thread since construction, for timing one phase of a tick.
+class AllocationScope {
+public:
+    AllocationScope()
+        : Start_(AllocationStats::Current())
+    {}
+
+    AllocationStats Get() const {
+        return AllocationStats::Current() - Start_;
+    }
+
+private:
+    AllocationStats Start_;
+};
@@ -0,0 +1,20 @@
+#pragma once
+
+#include <cstdint>
+
+// ENet channels shared by the server and clients.
+enum Channel : uint8_t {
+    ChannelSnapshots = 0,
+    ChannelClock = 1,
+    ChannelTerrain = 2,
+    // Zone redirects to clients, and zone to zone messages on the links between zone servers.
+    ChannelZone = 3,
+    // Lockstep state and input frames, reliable and in order.
+    ChannelLockstep = 4,
+    ChannelCount
+};
+
+// Snapshot relays connect with a shared key as connect data, passed to the server and
+// the relay with --relay-key. The server gives a relay every object and no object of its
+// own, the relay fans the snapshots out to spectators. Clients connect with zero.
+constexpr uint32_t NoRelayKey = 0;
@@ -0,0 +1,26 @@
+#include <core/clock_sync.h>
+
+#include <algorithm>
+
+void ClockSync::AddSample(uint64_t clientSend, uint64_t serverTime, uint64_t clientReceive) {
+    if (clientReceive < clientSend) {
+        return;
+    }
+
+    Sample& sample = Samples_[Next_];
+    sample.RoundTrip = clientReceive - clientSend;
+    sample.Offset = (int64_t)serverTime - (int64_t)(clientSend + sample.RoundTrip / 2);
+
+    Next_ = (Next_ + 1) % Window_;
+    Count_ = std::min(Count_ + 1, Window_);
+
+    const Sample* best = &Samples_[0];
+    for (size_t i = 1; i < Count_; ++i) {
+        if (Samples_[i].RoundTrip < best->RoundTrip) {
+            best = &Samples_[i];
+        }
+    }
+
+    Offset_ = best->Offset;
+    RoundTrip_ = best->RoundTrip;
+}
@@ -0,0 +1,50 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+// NTP-style estimate of the offset between the local clock and the server clock.
+// Every sample is a request/response round trip; the offset is taken from the
+// sample with the smallest round trip in a sliding window since it has the
+// tightest error bound (half the round trip).
+class ClockSync {
+public:
+    // All times in nanoseconds: request sent and response received on the local clock,
+    // serverTime on the server clock when it answered.
+    void AddSample(uint64_t clientSend, uint64_t serverTime, uint64_t clientReceive);
+
+    bool IsSynchronized() const {
+        return Count_ > 0;
+    }
+
+    // Server clock minus local clock.
+    int64_t GetOffset() const {
+        return Offset_;
+    }
+
+    uint64_t GetRoundTrip() const {
+        return RoundTrip_;
+    }
+
+    size_t GetSampleCount() const {
+        return Count_;
+    }
+
+    uint64_t ToServerTime(uint64_t localTime) const {
+        return localTime + Offset_;
+    }
+
+private:
+    struct Sample {
+        int64_t Offset;
+        uint64_t RoundTrip;
+    };
+
+    static constexpr size_t Window_ = 16;
+    std::array<Sample, Window_> Samples_ = {};
+    size_t Count_ = 0;
+    size_t Next_ = 0;
+    int64_t Offset_ = 0;
+    uint64_t RoundTrip_ = 0;
+};
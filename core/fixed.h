@@ -0,0 +1,65 @@
+#pragma once
+
+#include <cmath>
+#include <compare>
+#include <cstdint>
+
+// Q16.16 fixed-point number. Integer arithmetic gives the same results on every
+// platform and compiler, which the lockstep simulation relies on. Conversions from
+// float are only done by the server when it turns client input into simulation input.
+struct Fixed {
+    static constexpr int FractionBits = 16;
+    static constexpr int32_t One = 1 << FractionBits;
+
+    int32_t Raw = 0;
+
+    static constexpr Fixed FromRaw(int32_t raw) {
+        Fixed value;
+        value.Raw = raw;
+        return value;
+    }
+
+    static constexpr Fixed FromInt(int32_t value) {
+        return FromRaw(value * One);
+    }
+
+    static Fixed FromFloat(float value) {
+        return FromRaw((int32_t)std::lround(value * One));
+    }
+
+    float ToFloat() const {
+        return Raw / (float)One;
+    }
+
+    // Sums wrap around instead of overflowing, so even out of range values stay deterministic.
+    constexpr Fixed operator+(Fixed other) const {
+        return FromRaw((int32_t)((uint32_t)Raw + (uint32_t)other.Raw));
+    }
+
+    constexpr Fixed operator-(Fixed other) const {
+        return FromRaw((int32_t)((uint32_t)Raw - (uint32_t)other.Raw));
+    }
+
+    constexpr Fixed operator-() const {
+        return FromRaw(-Raw);
+    }
+
+    constexpr Fixed operator*(Fixed other) const {
+        return FromRaw((int32_t)(((int64_t)Raw * other.Raw) >> FractionBits));
+    }
+
+    constexpr Fixed operator/(Fixed other) const {
+        return FromRaw((int32_t)(((int64_t)Raw << FractionBits) / other.Raw));
+    }
+
+    Fixed& operator+=(Fixed other) {
+        return *this = *this + other;
+    }
+
+    Fixed& operator-=(Fixed other) {
+        return *this = *this - other;
+    }
+
+    constexpr bool operator==(const Fixed& other) const = default;
+    constexpr auto operator<=>(const Fixed& other) const = default;
+};
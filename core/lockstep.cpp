@@ -0,0 +1,131 @@
+#include <core/lockstep.h>
+
+#include <algorithm>
+
+namespace {
+
+Fixed clamp_speed(int32_t raw) {
+    return Fixed::FromRaw(std::clamp(raw, -LockstepSimulation::MaxSpeed.Raw, LockstepSimulation::MaxSpeed.Raw));
+}
+
+void hash_word(uint64_t& hash, uint32_t word) {
+    hash ^= word;
+    hash *= 1099511628211ull;
+}
+
+}
+
+bool LockstepSimulation::Step(const proto::LockstepFrame& frame) {
+    if (frame.tick() != Tick_ + 1) {
+        return false;
+    }
+
+    for (uint32_t id : frame.leaves()) {
+        if (Body* body = Find(id)) {
+            Bodies_.erase(Bodies_.begin() + (body - Bodies_.data()));
+        }
+    }
+
+    for (uint32_t id : frame.joins()) {
+        auto it = std::lower_bound(Bodies_.begin(), Bodies_.end(), id, [](const Body& body, uint32_t id) {
+            return body.Id < id;
+        });
+        if (it == Bodies_.end() || it->Id != id) {
+            Bodies_.insert(it, Body { id });
+        }
+    }
+
+    for (const proto::LockstepInput& input : frame.inputs()) {
+        if (Body* body = Find(input.id())) {
+            body->VelocityX = clamp_speed(input.velocity_x());
+            body->VelocityY = clamp_speed(input.velocity_y());
+            body->Rotation = Fixed::FromRaw(input.rotation());
+        }
+    }
+
+    for (Body& body : Bodies_) {
+        body.X += body.VelocityX * Delta;
+        body.Y += body.VelocityY * Delta;
+    }
+
+    ++Tick_;
+    return true;
+}
+
+uint64_t LockstepSimulation::Hash() const {
+    uint64_t hash = 14695981039346656037ull;
+    hash_word(hash, (uint32_t)Tick_);
+    hash_word(hash, (uint32_t)(Tick_ >> 32));
+    for (const Body& body : Bodies_) {
+        hash_word(hash, body.Id);
+        hash_word(hash, body.X.Raw);
+        hash_word(hash, body.Y.Raw);
+        hash_word(hash, body.VelocityX.Raw);
+        hash_word(hash, body.VelocityY.Raw);
+        hash_word(hash, body.Rotation.Raw);
+    }
+    return hash;
+}
+
+void LockstepSimulation::EncodeState(proto::LockstepState& state) const {
+    state.set_tick(Tick_);
+    for (const Body& body : Bodies_) {
+        proto::LockstepBody* proto_body = state.add_bodies();
+        proto_body->set_id(body.Id);
+        proto_body->set_x(body.X.Raw);
+        proto_body->set_y(body.Y.Raw);
+        proto_body->set_velocity_x(body.VelocityX.Raw);
+        proto_body->set_velocity_y(body.VelocityY.Raw);
+        proto_body->set_rotation(body.Rotation.Raw);
+    }
+}
+
+void LockstepSimulation::DecodeState(const proto::LockstepState& state) {
+    Tick_ = state.tick();
+    Bodies_.clear();
+    for (const proto::LockstepBody& proto_body : state.bodies()) {
+        Bodies_.push_back(Body {
+            proto_body.id(),
+            Fixed::FromRaw(proto_body.x()),
+            Fixed::FromRaw(proto_body.y()),
+            clamp_speed(proto_body.velocity_x()),
+            clamp_speed(proto_body.velocity_y()),
+            Fixed::FromRaw(proto_body.rotation()),
+        });
+    }
+
+    std::sort(Bodies_.begin(), Bodies_.end(), [](const Body& a, const Body& b) {
+        return a.Id < b.Id;
+    });
+    Bodies_.erase(std::unique(Bodies_.begin(), Bodies_.end(), [](const Body& a, const Body& b) {
+        return a.Id == b.Id;
+    }), Bodies_.end());
+}
+
+void LockstepSimulation::EncodeInput(uint32_t id, const proto::UserUpdate& update, proto::LockstepInput* input) {
+    input->set_id(id);
+    input->set_velocity_x(Fixed::FromFloat(std::clamp(update.velocity().x(), -1.0f, 1.0f) * MaxSpeed.ToFloat()).Raw);
+    input->set_velocity_y(Fixed::FromFloat(std::clamp(update.velocity().y(), -1.0f, 1.0f) * MaxSpeed.ToFloat()).Raw);
+    input->set_rotation(std::isfinite(update.rotation()) ? Fixed::FromFloat(std::remainder(update.rotation(), 6.2831853f)).Raw : 0);
+}
+
+void LockstepSimulation::ToObjects(std::vector<Object>& out) const {
+    for (const Body& body : Bodies_) {
+        // Lockstep replication carries no colors, derive a stable one from the id.
+        uint32_t hash = body.Id * 2654435761u;
+
+        Object& object = out.emplace_back();
+        object.id = body.Id;
+        object.color = Eigen::Vector3f((hash & 0xff) / 255.0f, ((hash >> 8) & 0xff) / 255.0f, ((hash >> 16) & 0xff) / 255.0f);
+        object.position = Eigen::Vector2f(body.X.ToFloat(), body.Y.ToFloat());
+        object.velocity = Eigen::Vector2f(body.VelocityX.ToFloat(), body.VelocityY.ToFloat());
+        object.rotation = body.Rotation.ToFloat();
+    }
+}
+
+LockstepSimulation::Body* LockstepSimulation::Find(uint32_t id) {
+    auto it = std::lower_bound(Bodies_.begin(), Bodies_.end(), id, [](const Body& body, uint32_t id) {
+        return body.Id < id;
+    });
+    return it != Bodies_.end() && it->Id == id ? &*it : nullptr;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <core/fixed.h>
+#include <core/object.h>
+
+#include <object.pb.h>
+
+#include <cstdint>
+#include <vector>
+
+// Deterministic movement simulation in fixed point with a fixed tick. The state
+// after a tick is a pure function of the previous state and the tick's frame, so
+// the server only replicates input frames and every client steps its own copy,
+// bit-exact on any platform. Replaying the frames from an initial state reproduces a run.
+class LockstepSimulation {
+public:
+    // Simulated time per tick, the server runs ticks at this fixed rate.
+    static constexpr uint64_t DeltaNs = 10'000'000;
+    static constexpr Fixed Delta = Fixed::FromRaw(Fixed::One / 100);
+    static constexpr Fixed MaxSpeed = Fixed::FromInt(10);
+
+    // Joined bodies start at rest at the origin.
+    struct Body {
+        uint32_t Id = 0;
+        Fixed X = {};
+        Fixed Y = {};
+        Fixed VelocityX = {};
+        Fixed VelocityY = {};
+        Fixed Rotation = {};
+    };
+
+    // Applies the frame for GetTick() + 1 and advances one tick. Returns false
+    // without changing anything if the frame is for another tick.
+    bool Step(const proto::LockstepFrame& frame);
+
+    // FNV-1a over the 32-bit words of the tick and every body in id order.
+    uint64_t Hash() const;
+
+    void EncodeState(proto::LockstepState& state) const;
+    void DecodeState(const proto::LockstepState& state);
+
+    // Quantizes a client's input the way World::ApplyUserUpdate interprets it. Only
+    // the server converts from float, clients step with the quantized values.
+    static void EncodeInput(uint32_t id, const proto::UserUpdate& update, proto::LockstepInput* input);
+
+    // Appends the bodies as objects for rendering.
+    void ToObjects(std::vector<Object>& out) const;
+
+    uint64_t GetTick() const {
+        return Tick_;
+    }
+
+    // Sorted by id.
+    const std::vector<Body>& GetBodies() const {
+        return Bodies_;
+    }
+
+    size_t Size() const {
+        return Bodies_.size();
+    }
+
+private:
+    Body* Find(uint32_t id);
+
+private:
+    std::vector<Body> Bodies_;
+    uint64_t Tick_ = 0;
+};
@@ -0,0 +1,226 @@
+#include <core/loopback_transport.h>
+
+#include <algorithm>
+#include <chrono>
+
+namespace {
+
+uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// A reliable packet lost this many times in a row is delivered anyway, ENet would drop the peer instead.
+constexpr int MaxResends = 32;
+
+}
+
+LoopbackTransport::~LoopbackTransport() {
+    std::lock_guard<std::mutex> lock(Network_.Lock_);
+
+    for (uint32_t peer = 0; peer < Links_.size(); ++peer) {
+        Unlink(peer);
+    }
+    for (const TransportEvent& event : Inbox_) {
+        if (event.Packet) {
+            enet_packet_destroy(event.Packet);
+        }
+    }
+    for (; !InFlight_.empty(); InFlight_.pop()) {
+        enet_packet_destroy(InFlight_.top().Event.Packet);
+    }
+}
+
+uint32_t LoopbackTransport::Connect(LoopbackTransport& remote, const LinkConditions& conditions) {
+    std::lock_guard<std::mutex> lock(Network_.Lock_);
+
+    uint32_t local = Links_.size();
+    uint32_t remotePeer = remote.Links_.size();
+    Links_.emplace_back(&remote, remotePeer, conditions);
+    remote.Links_.emplace_back(this, local, conditions);
+
+    Push(TransportEvent { TransportEventType::Connect, local });
+    remote.Push(TransportEvent { TransportEventType::Connect, remotePeer });
+    return local;
+}
+
+void LoopbackTransport::SetConditions(uint32_t peer, const LinkConditions& conditions) {
+    std::lock_guard<std::mutex> lock(Network_.Lock_);
+
+    if (peer < Links_.size()) {
+        Links_[peer].Conditions = conditions;
+    }
+}
+
+bool LoopbackTransport::Service(std::vector<TransportEvent>& out, uint32_t timeout) {
+    std::unique_lock<std::mutex> lock(Network_.Lock_);
+
+    const uint64_t deadline = now() + (uint64_t)timeout * 1000000;
+    while (true) {
+        uint64_t time = now();
+        uint64_t next = InFlight_.empty() ? 0 : Land(time);
+        if (!Inbox_.empty() || time >= deadline) {
+            break;
+        }
+
+        // Senders notify on every push, so a packet arriving earlier than next also wakes us.
+        uint64_t wake = next ? std::min(next, deadline) : deadline;
+        Ready_.wait_until(lock, std::chrono::steady_clock::time_point(std::chrono::nanoseconds(wake)));
+    }
+
+    out.insert(out.end(), Inbox_.begin(), Inbox_.end());
+    Inbox_.clear();
+    return true;
+}
+
+void LoopbackTransport::Send(uint32_t peer, uint8_t channel, ENetPacket* packet) {
+    {
+        std::lock_guard<std::mutex> lock(Network_.Lock_);
+        if (peer < Links_.size() && Links_[peer].Remote) {
+            Deliver(Links_[peer], channel, packet);
+            return;
+        }
+    }
+
+    enet_packet_destroy(packet);
+}
+
+void LoopbackTransport::Broadcast(uint8_t channel, ENetPacket* packet) {
+    {
+        std::lock_guard<std::mutex> lock(Network_.Lock_);
+
+        // Receivers free what they get, so all but the last one get their own copy.
+        Link* last = nullptr;
+        for (Link& link : Links_) {
+            if (!link.Remote) {
+                continue;
+            }
+            if (last) {
+                Deliver(*last, channel, enet_packet_create(packet->data, packet->dataLength, packet->flags & ~ENET_PACKET_FLAG_NO_ALLOCATE));
+            }
+            last = &link;
+        }
+
+        if (last) {
+            Deliver(*last, channel, packet);
+            return;
+        }
+    }
+
+    enet_packet_destroy(packet);
+}
+
+void LoopbackTransport::Disconnect(uint32_t peer) {
+    std::lock_guard<std::mutex> lock(Network_.Lock_);
+
+    if (peer < Links_.size() && Links_[peer].Remote) {
+        Unlink(peer);
+        Push(TransportEvent { TransportEventType::Disconnect, peer });
+    }
+}
+
+void LoopbackTransport::Push(const TransportEvent& event) {
+    Inbox_.push_back(event);
+    Ready_.notify_one();
+}
+
+void LoopbackTransport::Deliver(Link& link, uint8_t channel, ENetPacket* packet) {
+    const TransportEvent event { TransportEventType::Receive, link.RemotePeer, channel, 0, packet };
+    const LinkConditions& conditions = link.Conditions;
+    if (conditions.IsPerfect()) {
+        link.Remote->Push(event);
+        return;
+    }
+
+    const bool reliable = packet->flags & ENET_PACKET_FLAG_RELIABLE;
+    const bool unsequenced = packet->flags & ENET_PACKET_FLAG_UNSEQUENCED;
+    const uint64_t time = now();
+
+    uint64_t start = std::max(time, link.BusyUntil);
+    if (!reliable && conditions.MaxQueueDelay && start - time > conditions.MaxQueueDelay) {
+        ++link.Remote->Dropped_;
+        enet_packet_destroy(packet);
+        return;
+    }
+    link.BusyUntil = start + (conditions.Bandwidth ? packet->dataLength * 1000000000 / conditions.Bandwidth : 0);
+
+    uint64_t arrival = link.BusyUntil + conditions.Latency + (uint64_t)(Random() * conditions.Jitter);
+    for (int attempt = 0; attempt < MaxResends && Random() < conditions.Loss; ++attempt) {
+        if (!reliable) {
+            ++link.Remote->Dropped_;
+            enet_packet_destroy(packet);
+            return;
+        }
+        // The resend goes out once the missing acknowledgement is noticed, a round trip later.
+        arrival += 2 * conditions.Latency + conditions.Jitter;
+    }
+    if (unsequenced && Random() < conditions.Reorder) {
+        arrival += std::max(conditions.Latency, conditions.Jitter);
+    }
+
+    uint32_t sequence = 0;
+    if (!unsequenced) {
+        if (channel >= link.LastReliable.size()) {
+            link.LastReliable.resize(channel + 1, 0);
+            link.SentSequence.resize(channel + 1, 0);
+        }
+        if (reliable) {
+            arrival = std::max(arrival, link.LastReliable[channel]);
+            link.LastReliable[channel] = arrival;
+        } else {
+            sequence = ++link.SentSequence[channel];
+        }
+    }
+
+    LoopbackTransport& remote = *link.Remote;
+    remote.InFlight_.push(InFlight { arrival, remote.InFlightOrder_++, sequence, event });
+    remote.Ready_.notify_one();
+}
+
+uint64_t LoopbackTransport::Land(uint64_t time) {
+    for (; !InFlight_.empty() && InFlight_.top().Time <= time; InFlight_.pop()) {
+        const InFlight& packet = InFlight_.top();
+        const TransportEvent& event = packet.Event;
+        Link& link = Links_[event.Peer];
+
+        // Packets still on the wire when the link went down are lost with it.
+        if (!link.Remote) {
+            enet_packet_destroy(event.Packet);
+            continue;
+        }
+
+        // A sequenced unreliable packet overtaken by a newer one is discarded.
+        if (packet.Sequence) {
+            if (event.Channel >= link.LandedSequence.size()) {
+                link.LandedSequence.resize(event.Channel + 1, 0);
+            }
+            if (packet.Sequence <= link.LandedSequence[event.Channel]) {
+                ++Dropped_;
+                enet_packet_destroy(event.Packet);
+                continue;
+            }
+            link.LandedSequence[event.Channel] = packet.Sequence;
+        }
+
+        Inbox_.push_back(event);
+    }
+    return InFlight_.empty() ? 0 : InFlight_.top().Time;
+}
+
+void LoopbackTransport::Unlink(uint32_t peer) {
+    Link& link = Links_[peer];
+    if (!link.Remote) {
+        return;
+    }
+
+    link.Remote->Links_[link.RemotePeer].Remote = nullptr;
+    link.Remote->Push(TransportEvent { TransportEventType::Disconnect, link.RemotePeer });
+    link.Remote = nullptr;
+}
+
+float LoopbackTransport::Random() {
+    // xorshift32, returns [0, 1).
+    Rng_ ^= Rng_ << 13;
+    Rng_ ^= Rng_ >> 17;
+    Rng_ ^= Rng_ << 5;
+    return (Rng_ >> 8) / (float)(1 << 24);
+}
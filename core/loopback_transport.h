@@ -0,0 +1,131 @@
+#pragma once
+
+#include <core/transport.h>
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <queue>
+
+// Shared state of in-process transports that can connect to each other.
+// Must outlive all of them.
+class LoopbackNetwork {
+private:
+    friend class LoopbackTransport;
+
+    // One lock for all transports, a send touches the queues of both ends.
+    std::mutex Lock_;
+};
+
+// Simulated conditions of one direction of a loopback link. All zero is a perfect link.
+struct LinkConditions {
+    // One way delay, in nanoseconds.
+    uint64_t Latency = 0;
+    // Uniformly distributed extra delay in [0, Jitter], in nanoseconds.
+    uint64_t Jitter = 0;
+    // Probability a datagram is lost. Unreliable packets are dropped, reliable ones
+    // arrive a round trip later for every lost attempt, like an ENet resend.
+    float Loss = 0.0f;
+    // Probability an unsequenced packet is held back by an extra Latency, landing behind later ones.
+    float Reorder = 0.0f;
+    // Link capacity in bytes per second, 0 is unlimited. Packets queue behind each other.
+    uint64_t Bandwidth = 0;
+    // Unreliable packets that would wait longer than this for the link are dropped,
+    // like ENet throttling a congested peer. 0 keeps them all.
+    uint64_t MaxQueueDelay = 0;
+
+    bool IsPerfect() const {
+        return Latency == 0 && Jitter == 0 && Loss <= 0.0f && Reorder <= 0.0f && Bandwidth == 0;
+    }
+};
+
+// In-process transport without sockets: packets are handed to the other end's
+// queue as is, so runs are reproducible. Lets the server, bots and clients run in
+// one process for tests and benchmarks. Links are perfect unless conditions are
+// given, then latency, jitter, loss, reordering and bandwidth are simulated with a
+// seeded generator while keeping ENet's ordering guarantees: reliable packets stay
+// in order, sequenced unreliable ones are dropped when older than one already delivered.
+// Thread safe, every transport is usually serviced by its own thread.
+class LoopbackTransport : public ITransport {
+public:
+    explicit LoopbackTransport(LoopbackNetwork& network, uint32_t seed = 1)
+        : Network_(network)
+        , Rng_(seed ? seed : 1)
+    {}
+
+    ~LoopbackTransport() override;
+
+    LoopbackTransport(const LoopbackTransport&) = delete;
+    LoopbackTransport& operator=(const LoopbackTransport&) = delete;
+
+    // Connects to another transport on the same network, both directions get the
+    // given conditions. Both ends get a Connect event, returns the local handle of the new peer.
+    uint32_t Connect(LoopbackTransport& remote, const LinkConditions& conditions = {});
+
+    // Changes the conditions of packets sent from this end to peer.
+    void SetConditions(uint32_t peer, const LinkConditions& conditions);
+
+    bool Service(std::vector<TransportEvent>& out, uint32_t timeout) override;
+    void Send(uint32_t peer, uint8_t channel, ENetPacket* packet) override;
+    void Broadcast(uint8_t channel, ENetPacket* packet) override;
+    void Disconnect(uint32_t peer) override;
+
+    // Packets to this end that the simulated links lost, throttled or discarded as stale.
+    uint64_t GetDropped() const {
+        return Dropped_;
+    }
+
+private:
+    struct Link {
+        Link(LoopbackTransport* remote, uint32_t remotePeer, const LinkConditions& conditions)
+            : Remote(remote)
+            , RemotePeer(remotePeer)
+            , Conditions(conditions)
+        {}
+
+        // Null once disconnected. Handles are never reused, so events still queued
+        // for an old connection cannot be mistaken for a new one.
+        LoopbackTransport* Remote = nullptr;
+        uint32_t RemotePeer = 0;
+        LinkConditions Conditions;
+        // When the simulated wire is free again.
+        uint64_t BusyUntil = 0;
+        // Per channel state for ENet's ordering rules: arrival time of the last reliable
+        // packet sent, last sequence number sent and last one received.
+        std::vector<uint64_t> LastReliable;
+        std::vector<uint32_t> SentSequence;
+        std::vector<uint32_t> LandedSequence;
+    };
+
+    struct InFlight {
+        uint64_t Time;
+        uint64_t Order;
+        // Sequence number of a sequenced unreliable packet, 0 for the others.
+        uint32_t Sequence;
+        TransportEvent Event;
+
+        bool operator>(const InFlight& other) const {
+            return Time != other.Time ? Time > other.Time : Order > other.Order;
+        }
+    };
+
+    // The methods below must be called with the network lock held.
+    void Push(const TransportEvent& event);
+    void Deliver(Link& link, uint8_t channel, ENetPacket* packet);
+    void Unlink(uint32_t peer);
+    // Moves packets that arrived by time to the inbox, returns the next arrival time or 0.
+    uint64_t Land(uint64_t time);
+    float Random();
+
+private:
+    LoopbackNetwork& Network_;
+    std::condition_variable Ready_;
+    std::deque<TransportEvent> Inbox_;
+    std::priority_queue<InFlight, std::vector<InFlight>, std::greater<InFlight>> InFlight_;
+    uint64_t InFlightOrder_ = 0;
+    std::vector<Link> Links_;
+    uint32_t Rng_;
+    std::atomic<uint64_t> Dropped_ = 0;
+};
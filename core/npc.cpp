@@ -0,0 +1,210 @@
+#include <core/npc.h>
+
+#include <algorithm>
+#include <bit>
+#include <cmath>
+
+NpcSystem::NpcSystem(const NpcConfig& config)
+    : Config_(config)
+{}
+
+uint32_t NpcSystem::Spawn(World& world, const Eigen::Vector2f& position, NpcBehavior behavior) {
+    Object& object = world.CreateObject();
+    object.position = position;
+
+    Index_[object.id] = Ids_.size();
+    Ids_.push_back(object.id);
+    Behavior_.push_back(behavior);
+    WanderAngle_.push_back(Random() * 3.14159265f);
+    return object.id;
+}
+
+void NpcSystem::Despawn(World& world, uint32_t id) {
+    auto it = Index_.find(id);
+    if (it == Index_.end()) {
+        return;
+    }
+
+    // Swap with the last agent to keep the arrays dense.
+    size_t slot = it->second;
+    size_t last = Ids_.size() - 1;
+    Index_[Ids_[last]] = slot;
+    Ids_[slot] = Ids_[last];
+    Behavior_[slot] = Behavior_[last];
+    WanderAngle_[slot] = WanderAngle_[last];
+
+    Ids_.pop_back();
+    Behavior_.pop_back();
+    WanderAngle_.pop_back();
+    Index_.erase(id);
+
+    world.RemoveObject(id);
+}
+
+uint32_t NpcSystem::CellOf(float x, float y) const {
+    int32_t cx = (int32_t)std::floor(x / Config_.NeighbourRadius);
+    int32_t cy = (int32_t)std::floor(y / Config_.NeighbourRadius);
+    uint32_t hash = (uint32_t)cx * 73856093u ^ (uint32_t)cy * 19349663u;
+    return hash & BucketMask_;
+}
+
+float NpcSystem::Random() {
+    // xorshift32, deterministic and cheap, returns [-1, 1].
+    Rng_ ^= Rng_ << 13;
+    Rng_ ^= Rng_ >> 17;
+    Rng_ ^= Rng_ << 5;
+    return (Rng_ & 0xffffff) / (float)0x7fffff - 1.0f;
+}
+
+void NpcSystem::Update(World& world, float delta) {
+    // Resolve, despawning swaps the last agent into slot i.
+    Objects_.clear();
+    for (size_t i = 0; i < Ids_.size();) {
+        if (Object* object = world.Find(Ids_[i])) {
+            Objects_.push_back(object);
+            ++i;
+        } else {
+            Despawn(world, Ids_[i]);
+        }
+    }
+
+    const size_t count = Ids_.size();
+    if (count == 0) {
+        return;
+    }
+
+    // Gather.
+    X_.resize(count);
+    Y_.resize(count);
+    VX_.resize(count);
+    VY_.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        const Object& object = *Objects_[i];
+        X_[i] = object.position.x();
+        Y_[i] = object.position.y();
+        VX_[i] = object.velocity.x();
+        VY_[i] = object.velocity.y();
+    }
+
+    // Bucket into a hashed grid, the table has a power of two size of at least twice
+    // the agent count plus one trailing slot for the end of the last bucket.
+    size_t buckets = std::bit_ceil(std::max<size_t>(count * 2, 16));
+    BucketMask_ = buckets - 1;
+    CellStart_.assign(buckets + 1, 0);
+    Cell_.resize(count);
+    for (size_t i = 0; i < count; ++i) {
+        Cell_[i] = CellOf(X_[i], Y_[i]);
+        ++CellStart_[Cell_[i] + 1];
+    }
+    for (size_t i = 1; i <= buckets; ++i) {
+        CellStart_[i] += CellStart_[i - 1];
+    }
+
+    Order_.resize(count);
+    SortedX_.resize(count);
+    SortedY_.resize(count);
+    SortedVX_.resize(count);
+    SortedVY_.resize(count);
+    {
+        // CellStart_ doubles as the insertion cursor and is restored afterwards.
+        for (size_t i = 0; i < count; ++i) {
+            uint32_t slot = CellStart_[Cell_[i]]++;
+            Order_[slot] = i;
+            SortedX_[slot] = X_[i];
+            SortedY_[slot] = Y_[i];
+            SortedVX_[slot] = VX_[i];
+            SortedVY_[slot] = VY_[i];
+        }
+        for (size_t i = buckets; i > 0; --i) {
+            CellStart_[i] = CellStart_[i - 1];
+        }
+        CellStart_[0] = 0;
+    }
+
+    const float radius2 = Config_.NeighbourRadius * Config_.NeighbourRadius;
+    const float bounds2 = Config_.Bounds * Config_.Bounds;
+
+    // Steer, walking agents in cell order so neighbouring agents share cache lines.
+    for (size_t s = 0; s < count; ++s) {
+        const size_t i = Order_[s];
+        const float x = SortedX_[s];
+        const float y = SortedY_[s];
+        const float vx = SortedVX_[s];
+        const float vy = SortedVY_[s];
+
+        WanderAngle_[i] += Random() * Config_.WanderRate * delta;
+        float ax = std::cos(WanderAngle_[i]) * Config_.MaxSpeed * Config_.WanderWeight;
+        float ay = std::sin(WanderAngle_[i]) * Config_.MaxSpeed * Config_.WanderWeight;
+
+        if (Behavior_[i] == NpcBehavior::Flock) {
+            float sepX = 0, sepY = 0, aliX = 0, aliY = 0, cohX = 0, cohY = 0;
+            size_t neighbours = 0;
+
+            uint32_t visited[9];
+            size_t visitedCount = 0;
+            for (int dx = -1; dx <= 1 && neighbours < Config_.MaxNeighbours; ++dx) {
+                for (int dy = -1; dy <= 1 && neighbours < Config_.MaxNeighbours; ++dy) {
+                    uint32_t cell = CellOf(x + dx * Config_.NeighbourRadius, y + dy * Config_.NeighbourRadius);
+                    // Distinct cells may hash to one bucket, visit it once.
+                    if (std::find(visited, visited + visitedCount, cell) != visited + visitedCount) {
+                        continue;
+                    }
+                    visited[visitedCount++] = cell;
+
+                    for (uint32_t j = CellStart_[cell]; j < CellStart_[cell + 1] && neighbours < Config_.MaxNeighbours; ++j) {
+                        float ox = x - SortedX_[j];
+                        float oy = y - SortedY_[j];
+                        float d2 = ox * ox + oy * oy;
+                        if (j == s || d2 > radius2 || d2 == 0.0f) {
+                            continue;
+                        }
+                        sepX += ox / d2;
+                        sepY += oy / d2;
+                        aliX += SortedVX_[j];
+                        aliY += SortedVY_[j];
+                        cohX += SortedX_[j];
+                        cohY += SortedY_[j];
+                        ++neighbours;
+                    }
+                }
+            }
+
+            if (neighbours > 0) {
+                float inv = 1.0f / neighbours;
+                ax += sepX * Config_.SeparationWeight * Config_.MaxSpeed;
+                ay += sepY * Config_.SeparationWeight * Config_.MaxSpeed;
+                ax += (aliX * inv - vx) * Config_.AlignmentWeight;
+                ay += (aliY * inv - vy) * Config_.AlignmentWeight;
+                ax += (cohX * inv - x) * Config_.CohesionWeight;
+                ay += (cohY * inv - y) * Config_.CohesionWeight;
+            }
+        }
+
+        if (x * x + y * y > bounds2) {
+            ax -= x / Config_.Bounds * Config_.MaxSpeed;
+            ay -= y / Config_.Bounds * Config_.MaxSpeed;
+        }
+
+        float force = std::sqrt(ax * ax + ay * ay);
+        if (force > Config_.MaxForce) {
+            ax *= Config_.MaxForce / force;
+            ay *= Config_.MaxForce / force;
+        }
+
+        float nvx = vx + ax * delta;
+        float nvy = vy + ay * delta;
+        float speed = std::sqrt(nvx * nvx + nvy * nvy);
+        if (speed > Config_.MaxSpeed) {
+            nvx *= Config_.MaxSpeed / speed;
+            nvy *= Config_.MaxSpeed / speed;
+        }
+        VX_[i] = nvx;
+        VY_[i] = nvy;
+    }
+
+    // Scatter.
+    for (size_t i = 0; i < count; ++i) {
+        Objects_[i]->velocity = Eigen::Vector2f(VX_[i], VY_[i]);
+        Objects_[i]->rotation = std::atan2(VY_[i], VX_[i]);
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+#include <core/world.h>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+enum class NpcBehavior : uint8_t {
+    Wander,
+    Flock,
+};
+
+struct NpcConfig {
+    float MaxSpeed = 5.0f;
+    float MaxForce = 10.0f;
+    float WanderRate = 2.0f;
+    float NeighbourRadius = 4.0f;
+    // Caps the work per agent in dense crowds.
+    size_t MaxNeighbours = 16;
+    float SeparationWeight = 1.5f;
+    float AlignmentWeight = 1.0f;
+    float CohesionWeight = 0.5f;
+    float WanderWeight = 1.0f;
+    // Agents further than this from the origin are steered back.
+    float Bounds = 200.0f;
+};
+
+// Server owned entities with data-oriented steering. Agent state lives in
+// structure-of-arrays storage; every tick agents are bucketed into a uniform grid
+// with a counting sort, copied into cell order and updated in one pass that reads
+// neighbours from contiguous memory. Agents are regular world objects for
+// replication, looked up by id every tick, only their velocity is written back.
+class NpcSystem {
+public:
+    explicit NpcSystem(const NpcConfig& config = {});
+
+    uint32_t Spawn(World& world, const Eigen::Vector2f& position, NpcBehavior behavior);
+    void Despawn(World& world, uint32_t id);
+
+    // Computes steering for every agent and sets the velocities World::Step integrates.
+    // Agents whose objects were removed from world by other means are despawned.
+    void Update(World& world, float delta);
+
+    size_t Size() const {
+        return Ids_.size();
+    }
+
+private:
+    uint32_t CellOf(float x, float y) const;
+    float Random();
+
+private:
+    NpcConfig Config_;
+    uint32_t Rng_ = 0x9e3779b9;
+    uint32_t BucketMask_ = 0;
+
+    std::unordered_map<uint32_t, size_t> Index_;
+    std::vector<uint32_t> Ids_;
+    std::vector<NpcBehavior> Behavior_;
+    std::vector<float> WanderAngle_;
+
+    // Per-tick scratch, reused so steady state updates do not allocate.
+    // Objects are resolved through the world every tick, pointers are not kept across ticks.
+    std::vector<Object*> Objects_;
+    std::vector<float> X_;
+    std::vector<float> Y_;
+    std::vector<float> VX_;
+    std::vector<float> VY_;
+    std::vector<uint32_t> Cell_;
+    std::vector<uint32_t> CellStart_;
+    std::vector<uint32_t> Order_;
+    std::vector<float> SortedX_;
+    std::vector<float> SortedY_;
+    std::vector<float> SortedVX_;
+    std::vector<float> SortedVY_;
+};
@@ -0,0 +1,76 @@
+#include <core/packet_pool.h>
+
+#include <cstdlib>
+
+PacketPool::~PacketPool() {
+    for (auto& list : Free_) {
+        for (Buffer* buffer : list) {
+            free(buffer);
+        }
+    }
+}
+
+ENetPacket* PacketPool::Create(const google::protobuf::MessageLite& message, enet_uint32 flags) {
+    size_t size = message.ByteSizeLong();
+    Buffer* buffer = Acquire(size);
+    message.SerializeWithCachedSizesToArray(Data(buffer));
+
+    ENetPacket* packet = enet_packet_create(Data(buffer), size, flags | ENET_PACKET_FLAG_NO_ALLOCATE);
+    if (!packet) {
+        Release(buffer);
+        return nullptr;
+    }
+    packet->userData = buffer;
+    packet->freeCallback = &PacketPool::FreeCallback;
+    return packet;
+}
+
+PacketPool::Buffer* PacketPool::Acquire(size_t size) {
+    size_t sizeClass = 0;
+    while (sizeClass < Classes_ && ClassSize(sizeClass) < size) {
+        ++sizeClass;
+    }
+
+    ++Outstanding_;
+
+    if (sizeClass < Classes_) {
+        std::lock_guard<std::mutex> lock(Lock_);
+        auto& list = Free_[sizeClass];
+        if (!list.empty()) {
+            Buffer* buffer = list.back();
+            list.pop_back();
+            ++Hits_;
+            return buffer;
+        }
+    }
+
+    ++Misses_;
+    size_t capacity = sizeClass < Classes_ ? ClassSize(sizeClass) : size;
+    Buffer* buffer = static_cast<Buffer*>(malloc(sizeof(Buffer) + capacity));
+    if (!buffer) {
+        abort();
+    }
+    buffer->Pool = this;
+    buffer->Class = sizeClass;
+    return buffer;
+}
+
+void PacketPool::Release(Buffer* buffer) {
+    --Outstanding_;
+
+    if (buffer->Class < Classes_) {
+        std::lock_guard<std::mutex> lock(Lock_);
+        auto& list = Free_[buffer->Class];
+        if (list.size() < MaxFreePerClass_) {
+            list.push_back(buffer);
+            return;
+        }
+    }
+
+    free(buffer);
+}
+
+void PacketPool::FreeCallback(ENetPacket* packet) {
+    Buffer* buffer = static_cast<Buffer*>(packet->userData);
+    buffer->Pool->Release(buffer);
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <enet/enet.h>
+#include <google/protobuf/message_lite.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+// Pool of preallocated packet buffers that protobuf messages are serialized into
+// directly. Packets are created with ENET_PACKET_FLAG_NO_ALLOCATE so ENet neither
+// copies the data nor frees it; ENet's freeCallback hands the buffer back once the
+// packet's last reference (one per peer it was queued to) is released.
+// Thread safe. Must outlive every packet it created.
+class PacketPool {
+public:
+    explicit PacketPool(size_t maxFreePerClass = 256)
+        : MaxFreePerClass_(maxFreePerClass)
+    {}
+
+    ~PacketPool();
+
+    PacketPool(const PacketPool&) = delete;
+    PacketPool& operator=(const PacketPool&) = delete;
+
+    ENetPacket* Create(const google::protobuf::MessageLite& message, enet_uint32 flags);
+
+    // Buffers reused from a free list.
+    uint64_t GetHits() const {
+        return Hits_;
+    }
+
+    // Buffers that had to be allocated, including ones larger than the biggest class.
+    uint64_t GetMisses() const {
+        return Misses_;
+    }
+
+    // Buffers currently owned by ENet.
+    uint64_t GetOutstanding() const {
+        return Outstanding_;
+    }
+
+private:
+    struct Buffer {
+        PacketPool* Pool;
+        // Index into Free_, or Classes_ for an oversized one-off buffer.
+        size_t Class;
+    };
+
+    // Size classes grow by 4x from 256 bytes to 256 KiB.
+    static constexpr size_t Classes_ = 6;
+    static constexpr size_t MinSize_ = 256;
+
+    static size_t ClassSize(size_t sizeClass) {
+        return MinSize_ << (2 * sizeClass);
+    }
+
+    static uint8_t* Data(Buffer* buffer) {
+        return reinterpret_cast<uint8_t*>(buffer + 1);
+    }
+
+    Buffer* Acquire(size_t size);
+    void Release(Buffer* buffer);
+    static void FreeCallback(ENetPacket* packet);
+
+private:
+    size_t MaxFreePerClass_;
+    std::mutex Lock_;
+    std::array<std::vector<Buffer*>, Classes_> Free_;
+    std::atomic<uint64_t> Hits_ = 0;
+    std::atomic<uint64_t> Misses_ = 0;
+    std::atomic<uint64_t> Outstanding_ = 0;
+};
@@ -0,0 +1,94 @@
+#include <core/replication.h>
+
+#include <algorithm>
+#include <cmath>
+
+bool PeerReplication::Encode(const World& world, const ReplicationConfig& config, proto::ObjectsVector& vector) {
+    bool reliable = false;
+
+    for (uint32_t id : world.GetObjectsToDelete()) {
+        if (Sent_.erase(id)) {
+            vector.add_objects_to_delete(id);
+            reliable = true;
+        }
+    }
+
+    const double time = world.GetTime();
+    // Counted per peer, world ticks may advance by more than one between broadcasts.
+    const uint64_t snapshot = Encodes_++;
+    const float threshold2 = config.PositionThreshold * config.PositionThreshold;
+    const float enter2 = config.InterestRadius * config.InterestRadius;
+    const float leave2 = (config.InterestRadius + config.InterestHysteresis) * (config.InterestRadius + config.InterestHysteresis);
+
+    for (const auto& [id, object] : world.GetObjects()) {
+        auto it = Sent_.find(id);
+        const bool created = it == Sent_.end();
+        const float distance2 = (object.position - Focus_).squaredNorm();
+
+        if (HasFocus_ && config.InterestRadius > 0.0f && distance2 > (created ? enter2 : leave2)) {
+            if (!created) {
+                Sent_.erase(it);
+                vector.add_objects_to_delete(id);
+                reliable = true;
+            }
+            continue;
+        }
+
+        if (created) {
+            Creations_.emplace_back(distance2, id);
+            continue;
+        }
+
+        if (HasFocus_ && !IsUpdateDue(config, id, snapshot, distance2)) {
+            continue;
+        }
+
+        SentState& sent = it->second;
+        const double elapsed = time - sent.Time;
+        if (elapsed < config.MaxInterval) {
+            Eigen::Vector2f predicted = sent.Position + sent.Velocity * (float)elapsed;
+            if ((predicted - object.position).squaredNorm() <= threshold2 &&
+                std::abs(sent.Rotation - object.rotation) <= config.RotationThreshold) {
+                continue;
+            }
+        }
+
+        Send(object, time, sent, vector);
+    }
+
+    // A late joiner's baseline streams in over several snapshots, nearest objects first.
+    if (config.MaxCreationsPerSnapshot > 0 && Creations_.size() > config.MaxCreationsPerSnapshot) {
+        auto last = Creations_.begin() + config.MaxCreationsPerSnapshot;
+        std::nth_element(Creations_.begin(), last, Creations_.end());
+        Creations_.erase(last, Creations_.end());
+        std::sort(Creations_.begin(), Creations_.end());
+    }
+
+    LastCreations_ = Creations_.size();
+    for (const auto& [distance2, id] : Creations_) {
+        Send(*world.Find(id), time, Sent_[id], vector);
+        reliable = true;
+    }
+    Creations_.clear();
+
+    return reliable;
+}
+
+void PeerReplication::Send(const Object& object, double time, SentState& sent, proto::ObjectsVector& vector) {
+    sent.Position = object.position;
+    sent.Velocity = object.velocity;
+    sent.Rotation = object.rotation;
+    sent.Time = time;
+    World::EncodeObject(object, vector.add_objects());
+}
+
+bool PeerReplication::IsUpdateDue(const ReplicationConfig& config, uint32_t id, uint64_t snapshot, float distance2) {
+    uint64_t period = 1;
+    for (float distance : config.UpdateRateDistances) {
+        if (distance2 <= distance * distance) {
+            break;
+        }
+        period *= 2;
+    }
+    return (id + snapshot) % period == 0;
+}
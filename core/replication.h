@@ -0,0 +1,77 @@
+#pragma once
+
+#include <core/world.h>
+
+#include <object.pb.h>
+
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+struct ReplicationConfig {
+    // Maximum distance between the client's extrapolation and the real position.
+    float PositionThreshold = 0.1f;
+    // Maximum rotation difference before the object is resent.
+    float RotationThreshold = 0.01f;
+    // Objects are refreshed at least this often, in seconds, so lost unreliable updates heal.
+    double MaxInterval = 1.0;
+    // Only objects within this distance of the peer's focus are sent, zero sends every object.
+    // Objects are deleted on the peer once they are InterestHysteresis further away.
+    float InterestRadius = 0.0f;
+    float InterestHysteresis = 5.0f;
+    // Ascending distances from the focus. Objects beyond the i-th are only considered every
+    // 2^(i+1) snapshots, staggered by id so every snapshot carries a share. Empty checks
+    // every object in every snapshot.
+    std::vector<float> UpdateRateDistances;
+    // Objects new to the peer sent per snapshot, nearest first, zero for no limit. Bounds
+    // the baseline of a late joiner so it streams in over several snapshots.
+    size_t MaxCreationsPerSnapshot = 0;
+};
+
+// Per-peer dead reckoning state. Remembers the position and velocity last sent
+// for every object, extrapolates it the way the client does and only encodes
+// objects whose extrapolation error exceeds the configured threshold.
+// With an interest radius only objects near the peer's focus are replicated, and
+// with update rate tiers distant objects are checked less often. Peers without a
+// focus, such as relays, get every object at the full rate.
+class PeerReplication {
+public:
+    // Fills vector with the objects this peer needs at the current world time, objects
+    // new to the peer last. Returns true if the snapshot carries creations/deletions and
+    // must be sent reliably.
+    bool Encode(const World& world, const ReplicationConfig& config, proto::ObjectsVector& vector);
+
+    // Number of objects at the end of the last encoded vector that are new to the peer.
+    size_t GetLastCreations() const {
+        return LastCreations_;
+    }
+
+    void SetFocus(const Eigen::Vector2f& focus) {
+        Focus_ = focus;
+        HasFocus_ = true;
+    }
+
+    size_t GetKnownObjects() const {
+        return Sent_.size();
+    }
+
+private:
+    struct SentState {
+        Eigen::Vector2f Position;
+        Eigen::Vector2f Velocity;
+        float Rotation;
+        double Time;
+    };
+
+    static bool IsUpdateDue(const ReplicationConfig& config, uint32_t id, uint64_t snapshot, float distance2);
+    static void Send(const Object& object, double time, SentState& sent, proto::ObjectsVector& vector);
+
+private:
+    std::unordered_map<uint32_t, SentState> Sent_;
+    Eigen::Vector2f Focus_ = Eigen::Vector2f::Zero();
+    bool HasFocus_ = false;
+    uint64_t Encodes_ = 0;
+    // Objects new to the peer by squared distance, scratch space reused by Encode.
+    std::vector<std::pair<float, uint32_t>> Creations_;
+    size_t LastCreations_ = 0;
+};
@@ -0,0 +1,170 @@
+#include <core/replication_client.h>
+#include <core/channels.h>
+
+#include <chrono>
+
+ReplicationClient::ReplicationClient(const ReplicationClientConfig& config)
+    : Config_(config)
+    , Snapshots_(config.MaxExtrapolation)
+{}
+
+void ReplicationClient::HandlePacket(uint8_t channel, const ENetPacket* packet, uint64_t localTime) {
+    switch (channel) {
+        case ChannelSnapshots: {
+            proto::ObjectsVector vector;
+            if (!vector.ParseFromArray(packet->data, packet->dataLength)) {
+                return;
+            }
+            if (vector.me_size() > 0) {
+                Me_ = vector.me(0);
+            }
+            Snapshots_.Apply(vector, vector.server_time());
+            break;
+        }
+
+        case ChannelClock: {
+            proto::ClockSync sync;
+            if (!sync.ParseFromArray(packet->data, packet->dataLength)) {
+                return;
+            }
+            Clock_.AddSample(sync.client_time(), sync.server_time(), localTime);
+            break;
+        }
+
+        case ChannelTerrain: {
+            proto::TerrainMessage message;
+            if (!message.ParseFromArray(packet->data, packet->dataLength)) {
+                return;
+            }
+            if (message.has_edits()) {
+                ApplyTerrainEdits(message.edits());
+                return;
+            }
+            if (!message.has_chunk()) {
+                return;
+            }
+
+            const proto::TerrainChunk& chunk = message.chunk();
+            glm::ivec3 coord(chunk.x(), chunk.y(), chunk.z());
+            TerrainChunk& terrain = TerrainChunks_[coord];
+            if (terrain.Decompress(coord, chunk.data())) {
+                terrain.EditSequence = chunk.edit_sequence();
+                UpdatedChunks_.insert(coord);
+            } else {
+                TerrainChunks_.erase(coord);
+            }
+            break;
+        }
+
+        case ChannelLockstep: {
+            proto::LockstepMessage message;
+            if (message.ParseFromArray(packet->data, packet->dataLength)) {
+                HandleLockstep(message);
+            }
+            break;
+        }
+
+        case ChannelZone: {
+            proto::ZoneRedirect redirect;
+            if (redirect.ParseFromArray(packet->data, packet->dataLength)) {
+                Redirect_ = redirect;
+            }
+            break;
+        }
+
+        default:
+            break;
+    }
+}
+
+void ReplicationClient::HandleLockstep(const proto::LockstepMessage& message) {
+    if (message.has_state()) {
+        Lockstep_.DecodeState(message.state());
+        LockstepStarted_ = true;
+        return;
+    }
+
+    // Frames up to the state's tick were already applied by the server before it sent the state.
+    if (!LockstepStarted_ || !message.has_frame() || message.frame().tick() <= Lockstep_.GetTick()) {
+        return;
+    }
+    if (Lockstep_.Step(message.frame()) && Lockstep_.Hash() != message.frame().hash()) {
+        ++Desyncs_;
+    }
+}
+
+void ReplicationClient::Reset() {
+    // The clock is kept, zone servers run on one machine and share it.
+    Snapshots_ = SnapshotBuffer(Config_.MaxExtrapolation);
+    Me_ = 0;
+    for (const auto& [coord, chunk] : TerrainChunks_) {
+        UpdatedChunks_.insert(coord);
+    }
+    TerrainChunks_.clear();
+    Lockstep_ = LockstepSimulation();
+    LockstepStarted_ = false;
+}
+
+void ReplicationClient::ApplyTerrainEdits(const proto::TerrainEdits& edits) {
+    std::vector<glm::ivec3> chunks;
+    for (const proto::TerrainEdit& proto_edit : edits.edits()) {
+        TerrainEdit edit;
+        if (!TerrainEdit::Decode(proto_edit, edit)) {
+            continue;
+        }
+
+        chunks.clear();
+        edit.GetAffectedChunks(chunks);
+        for (const glm::ivec3& coord : chunks) {
+            auto it = TerrainChunks_.find(coord);
+            if (it != TerrainChunks_.end() && it->second.EditSequence < edit.Sequence) {
+                edit.ApplyToChunk(it->second);
+                UpdatedChunks_.insert(coord);
+            }
+        }
+    }
+}
+
+void ReplicationClient::SendTerrainEdit(ITransport& transport, uint32_t server, const TerrainEdit& edit) {
+    proto::TerrainMessage message;
+    edit.Encode(message.mutable_edits()->add_edits());
+    auto data = message.SerializeAsString();
+    transport.Send(server, ChannelTerrain, enet_packet_create(data.data(), data.size(), ENET_PACKET_FLAG_RELIABLE));
+}
+
+void ReplicationClient::EvictTerrain(const glm::vec3& focus, int radius) {
+    glm::ivec3 center = TerrainChunk::ToChunk(focus);
+    std::erase_if(TerrainChunks_, [&center, radius](const auto& item) {
+        glm::ivec2 d(item.first.x - center.x, item.first.z - center.z);
+        return d.x * d.x + d.y * d.y > radius * radius;
+    });
+}
+
+void ReplicationClient::Update(ITransport& transport, uint32_t server, uint64_t localTime) {
+    uint64_t interval = Clock_.GetSampleCount() < Config_.ClockSyncFastSamples ? Config_.ClockSyncFastInterval : Config_.ClockSyncInterval;
+    if (LastClockRequest_ != 0 && localTime - LastClockRequest_ < interval) {
+        return;
+    }
+    LastClockRequest_ = localTime;
+
+    proto::ClockSync sync;
+    sync.set_client_time(localTime);
+    auto data = sync.SerializeAsString();
+    ENetPacket* packet = enet_packet_create(data.data(), data.size(), ENET_PACKET_FLAG_UNSEQUENCED);
+    transport.Send(server, ChannelClock, packet);
+}
+
+void ReplicationClient::Sample(uint64_t localTime, std::vector<Object>& out) const {
+    Snapshots_.Sample(GetRenderTime(localTime), out);
+    Lockstep_.ToObjects(out);
+}
+
+uint64_t ReplicationClient::GetRenderTime(uint64_t localTime) const {
+    // Until the first round trip completes the newest snapshot is the best guess of server time.
+    uint64_t serverTime = Clock_.IsSynchronized() ? Clock_.ToServerTime(localTime) : Snapshots_.GetNewestTime();
+    return serverTime > Config_.InterpolationDelay ? serverTime - Config_.InterpolationDelay : 0;
+}
+
+uint64_t ReplicationClient::LocalTime() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
@@ -0,0 +1,115 @@
+#pragma once
+
+#include <core/clock_sync.h>
+#include <core/lockstep.h>
+#include <core/snapshot_buffer.h>
+#include <core/terrain.h>
+#include <core/terrain_edit.h>
+#include <core/transport.h>
+
+#include <cstdint>
+#include <optional>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+struct ReplicationClientConfig {
+    // How far behind the estimated server time objects are rendered, in nanoseconds.
+    // Must cover the snapshot interval plus jitter for interpolation to have two states.
+    uint64_t InterpolationDelay = 100'000'000;
+    uint64_t MaxExtrapolation = 1'500'000'000;
+    uint64_t ClockSyncInterval = 1'000'000'000;
+    // The first samples are taken quickly so the estimate converges right after connecting.
+    uint64_t ClockSyncFastInterval = 100'000'000;
+    size_t ClockSyncFastSamples = 8;
+};
+
+// Client side replication: keeps the clock in sync with the server over a transport and
+// buffers timestamped snapshots to provide smooth object state at render time.
+class ReplicationClient {
+public:
+    explicit ReplicationClient(const ReplicationClientConfig& config = {});
+
+    // Feeds a packet received from the server. Does not take ownership of the packet.
+    void HandlePacket(uint8_t channel, const ENetPacket* packet, uint64_t localTime);
+
+    // Sends a clock sync request to the server when one is due.
+    void Update(ITransport& transport, uint32_t server, uint64_t localTime);
+
+    // Appends interpolated object states for the given local time to out, followed
+    // by the lockstep bodies when the server runs in lockstep mode.
+    void Sample(uint64_t localTime, std::vector<Object>& out) const;
+
+    uint64_t GetRenderTime(uint64_t localTime) const;
+
+    uint32_t GetMe() const {
+        return Me_;
+    }
+
+    const ClockSync& GetClock() const {
+        return Clock_;
+    }
+
+    const SnapshotBuffer& GetSnapshots() const {
+        return Snapshots_;
+    }
+
+    const LockstepSimulation& GetLockstep() const {
+        return Lockstep_;
+    }
+
+    // Lockstep frames whose state hash did not match the server's.
+    uint64_t GetDesyncs() const {
+        return Desyncs_;
+    }
+
+    const TerrainChunk* GetTerrainChunk(const glm::ivec3& coord) const {
+        auto it = TerrainChunks_.find(coord);
+        return it == TerrainChunks_.end() ? nullptr : &it->second;
+    }
+
+    // Coordinates of terrain chunks received or edited since the last call, only these need remeshing.
+    std::vector<glm::ivec3> TakeUpdatedChunks() {
+        std::vector<glm::ivec3> chunks(UpdatedChunks_.begin(), UpdatedChunks_.end());
+        UpdatedChunks_.clear();
+        return chunks;
+    }
+
+    // Asks the server to apply an edit, it comes back through the replicated edit log.
+    static void SendTerrainEdit(ITransport& transport, uint32_t server, const TerrainEdit& edit);
+
+    // Drops chunks further than radius chunks from focus horizontally, the server
+    // forgets it sent them and streams them again when they come back into range.
+    void EvictTerrain(const glm::vec3& focus, int radius);
+
+    // Set when the server handed this client's object to another zone server. The
+    // caller reconnects to the given port with the token as connect data and calls Reset.
+    std::optional<proto::ZoneRedirect> TakeRedirect() {
+        std::optional<proto::ZoneRedirect> redirect;
+        redirect.swap(Redirect_);
+        return redirect;
+    }
+
+    // Forgets the objects and terrain of the previous server, the new one sends its own.
+    void Reset();
+
+    // Local monotonic clock in nanoseconds.
+    static uint64_t LocalTime();
+
+private:
+    void ApplyTerrainEdits(const proto::TerrainEdits& edits);
+    void HandleLockstep(const proto::LockstepMessage& message);
+
+private:
+    ReplicationClientConfig Config_;
+    ClockSync Clock_;
+    SnapshotBuffer Snapshots_;
+    uint64_t LastClockRequest_ = 0;
+    uint32_t Me_ = 0;
+    std::unordered_map<glm::ivec3, TerrainChunk> TerrainChunks_;
+    std::unordered_set<glm::ivec3> UpdatedChunks_;
+    std::optional<proto::ZoneRedirect> Redirect_;
+    LockstepSimulation Lockstep_;
+    bool LockstepStarted_ = false;
+    uint64_t Desyncs_ = 0;
+};
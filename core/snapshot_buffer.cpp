@@ -0,0 +1,110 @@
+#include <core/snapshot_buffer.h>
+
+#include <algorithm>
+#include <cmath>
+#include <numbers>
+
+void SnapshotBuffer::Apply(const proto::ObjectsVector& vector, uint64_t serverTime) {
+    NewestTime_ = std::max(NewestTime_, serverTime);
+
+    for (uint32_t id : vector.objects_to_delete()) {
+        auto it = Tracks_.find(id);
+        if (it != Tracks_.end()) {
+            it->second.DeletedAt = std::min(it->second.DeletedAt, serverTime);
+        }
+    }
+
+    for (const proto::Object& object : vector.objects()) {
+        Track& track = Tracks_[object.id()];
+
+        // A state past the deletion means the object was created again, e.g. after leaving
+        // and reentering the interest radius. The old history belongs to the previous life.
+        if (serverTime > track.DeletedAt) {
+            track.Count = 0;
+            track.Head = 0;
+            track.DeletedAt = std::numeric_limits<uint64_t>::max();
+        }
+
+        // Unsequenced packets may arrive out of order, older states are useless.
+        if (track.Count > 0 && track.Get(track.Count - 1).Time >= serverTime) {
+            continue;
+        }
+
+        if (track.Count == 0) {
+            track.CreatedAt = serverTime;
+        }
+        track.Color = Eigen::Vector3f(object.color().r(), object.color().g(), object.color().b());
+        track.States[track.Head] = State {
+            serverTime,
+            Eigen::Vector2f(object.position().x(), object.position().y()),
+            Eigen::Vector2f(object.velocity().x(), object.velocity().y()),
+            object.rotation(),
+        };
+        track.Head = (track.Head + 1) % History_;
+        track.Count = std::min(track.Count + 1, History_);
+    }
+
+    // Deleted objects are kept around until the render time has certainly passed them.
+    std::erase_if(Tracks_, [this](const auto& item) {
+        const Track& track = item.second;
+        return track.DeletedAt < NewestTime_ && NewestTime_ - track.DeletedAt > MaxExtrapolation_;
+    });
+}
+
+void SnapshotBuffer::Sample(uint64_t serverTime, std::vector<Object>& out) const {
+    out.reserve(out.size() + Tracks_.size());
+
+    for (const auto& [id, track] : Tracks_) {
+        if (track.Count == 0 || serverTime >= track.DeletedAt || serverTime < track.CreatedAt) {
+            continue;
+        }
+
+        Object& object = out.emplace_back();
+        object.id = id;
+        object.color = track.Color;
+        Evaluate(track, serverTime, MaxExtrapolation_, object);
+    }
+}
+
+void SnapshotBuffer::Evaluate(const Track& track, uint64_t time, uint64_t maxExtrapolation, Object& object) {
+    const State& newest = track.Get(track.Count - 1);
+    if (time >= newest.Time) {
+        float dt = std::min(time - newest.Time, maxExtrapolation) / 1e9f;
+        object.position = newest.Position + newest.Velocity * dt;
+        object.velocity = newest.Velocity;
+        object.rotation = newest.Rotation;
+        return;
+    }
+
+    const State& oldest = track.Get(0);
+    if (time <= oldest.Time) {
+        object.position = oldest.Position;
+        object.velocity = oldest.Velocity;
+        object.rotation = oldest.Rotation;
+        return;
+    }
+
+    size_t i = track.Count - 1;
+    while (i > 0 && track.Get(i - 1).Time > time) {
+        --i;
+    }
+
+    const State& a = track.Get(i - 1);
+    const State& b = track.Get(i);
+
+    // Cubic Hermite between the two states: updates may be up to a dead reckoning
+    // interval apart, the velocities keep curved paths from being cut short.
+    float span = (b.Time - a.Time) / 1e9f;
+    float t = (time - a.Time) / 1e9f / span;
+    float t2 = t * t;
+    float t3 = t2 * t;
+    object.position =
+        a.Position * (2 * t3 - 3 * t2 + 1) +
+        a.Velocity * ((t3 - 2 * t2 + t) * span) +
+        b.Position * (-2 * t3 + 3 * t2) +
+        b.Velocity * ((t3 - t2) * span);
+    object.velocity = a.Velocity + (b.Velocity - a.Velocity) * t;
+
+    float delta = std::remainder(b.Rotation - a.Rotation, 2 * std::numbers::pi_v<float>);
+    object.rotation = a.Rotation + delta * t;
+}
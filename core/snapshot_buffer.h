@@ -0,0 +1,67 @@
+#pragma once
+
+#include <core/object.h>
+
+#include <object.pb.h>
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+// Client side history of timestamped object states.
+// Snapshots may be partial (dead reckoning only sends objects that drifted), so
+// history is kept per object. Sampling interpolates between the two states that
+// bracket the requested time and extrapolates with the last velocity past the newest one.
+class SnapshotBuffer {
+public:
+    // Maximum time, in nanoseconds, an object is extrapolated past its newest state.
+    explicit SnapshotBuffer(uint64_t maxExtrapolation = 1'500'000'000)
+        : MaxExtrapolation_(maxExtrapolation)
+    {}
+
+    // serverTime is the server clock timestamp of the snapshot, in nanoseconds.
+    void Apply(const proto::ObjectsVector& vector, uint64_t serverTime);
+
+    // Appends the state of every live object at the given server time to out.
+    void Sample(uint64_t serverTime, std::vector<Object>& out) const;
+
+    size_t Size() const {
+        return Tracks_.size();
+    }
+
+    uint64_t GetNewestTime() const {
+        return NewestTime_;
+    }
+
+private:
+    struct State {
+        uint64_t Time;
+        Eigen::Vector2f Position;
+        Eigen::Vector2f Velocity;
+        float Rotation;
+    };
+
+    static constexpr size_t History_ = 8;
+
+    struct Track {
+        Eigen::Vector3f Color;
+        std::array<State, History_> States;
+        size_t Count = 0;
+        size_t Head = 0;
+        uint64_t CreatedAt = 0;
+        uint64_t DeletedAt = std::numeric_limits<uint64_t>::max();
+
+        const State& Get(size_t i) const {
+            return States[(Head + History_ - Count + i) % History_];
+        }
+    };
+
+    static void Evaluate(const Track& track, uint64_t time, uint64_t maxExtrapolation, Object& object);
+
+private:
+    std::unordered_map<uint32_t, Track> Tracks_;
+    uint64_t NewestTime_ = 0;
+    uint64_t MaxExtrapolation_;
+};
@@ -0,0 +1,114 @@
+#include <core/snapshot_encoder.h>
+
+#include <google/protobuf/io/coded_stream.h>
+
+#include <algorithm>
+
+SnapshotEncoder::SnapshotEncoder(PacketPool& pool, size_t threads, size_t maxPacketSize)
+    : Pool_(pool)
+    , Threads_(std::max<size_t>(threads, 1))
+    , MaxPacketSize_(maxPacketSize)
+    , Workers_(Threads_)
+{}
+
+void SnapshotEncoder::Encode(const World& world, const ReplicationConfig& config, uint64_t serverTime, std::vector<SnapshotJob>& jobs) {
+    const size_t batches = std::min(Threads_, jobs.size());
+    // A single batch is cheaper to encode on the calling thread than to hand over.
+    if (batches <= 1) {
+        EncodeRange(world, config, serverTime, jobs.data(), jobs.data() + jobs.size());
+        return;
+    }
+
+    const size_t size = (jobs.size() + batches - 1) / batches;
+    Batches_.clear();
+    for (size_t begin = 0; begin < jobs.size(); begin += size) {
+        SnapshotJob* first = jobs.data() + begin;
+        SnapshotJob* last = jobs.data() + std::min(begin + size, jobs.size());
+        Batches_.push_back(Workers_.enqueue([this, &world, &config, serverTime, first, last]() {
+            EncodeRange(world, config, serverTime, first, last);
+        }));
+    }
+    for (std::future<void>& batch : Batches_) {
+        batch.get();
+    }
+}
+
+void SnapshotEncoder::EncodeRange(const World& world, const ReplicationConfig& config, uint64_t serverTime, SnapshotJob* begin, SnapshotJob* end) {
+    proto::ObjectsVector vector;
+    for (SnapshotJob* job = begin; job != end; ++job) {
+        vector.Clear();
+        job->Packets.clear();
+
+        bool reliable = job->Replication->Encode(world, config, vector);
+        if (vector.objects_size() == 0 && vector.objects_to_delete_size() == 0) {
+            continue;
+        }
+        vector.set_server_time(serverTime);
+        vector.set_tick(world.GetTick());
+
+        if (vector.ByteSizeLong() <= MaxPacketSize_) {
+            job->Packets.push_back(Create(vector, reliable));
+        } else {
+            Split(vector, job->Replication->GetLastCreations(), *job);
+        }
+    }
+}
+
+// Objects new to the peer come last in the vector. Deletions go first and only packets
+// carrying deletions or new objects are sent reliably, updates of known objects stay
+// unreliable. Reliable packets keep their order, so a deletion is applied before an
+// object recreated under the same id.
+void SnapshotEncoder::Split(const proto::ObjectsVector& vector, size_t creations, SnapshotJob& job) {
+    const size_t updates = vector.objects_size() - creations;
+
+    proto::ObjectsVector chunk;
+    chunk.set_server_time(vector.server_time());
+    chunk.set_tick(vector.tick());
+
+    const size_t header = chunk.ByteSizeLong();
+    size_t size = header;
+    auto flush = [&](bool reliable) {
+        job.Packets.push_back(Create(chunk, reliable));
+        chunk.clear_objects();
+        chunk.clear_objects_to_delete();
+        size = header;
+    };
+
+    for (uint32_t id : vector.objects_to_delete()) {
+        const size_t idSize = google::protobuf::io::CodedOutputStream::VarintSize32(id);
+        if (chunk.objects_to_delete_size() > 0 && size + idSize > MaxPacketSize_) {
+            flush(true);
+        }
+        // Tag and length prefix of the packed field, the length fits in two bytes.
+        if (chunk.objects_to_delete_size() == 0) {
+            size += 3;
+        }
+        chunk.add_objects_to_delete(id);
+        size += idSize;
+    }
+
+    bool reliable = chunk.objects_to_delete_size() > 0;
+    for (size_t i = 0; i < (size_t)vector.objects_size(); ++i) {
+        const proto::Object& object = vector.objects(i);
+        // Tag and length prefix, objects are far smaller than 128 bytes.
+        const size_t objectSize = object.ByteSizeLong() + 2;
+        const bool empty = chunk.objects_size() == 0 && chunk.objects_to_delete_size() == 0;
+        // New objects start a packet of their own, keeping updates out of reliable packets.
+        if (!empty && (size + objectSize > MaxPacketSize_ || (i == updates && chunk.objects_size() > 0))) {
+            flush(reliable);
+            reliable = false;
+        }
+
+        *chunk.add_objects() = object;
+        size += objectSize;
+        reliable |= i >= updates;
+    }
+
+    if (chunk.objects_size() > 0 || chunk.objects_to_delete_size() > 0) {
+        flush(reliable);
+    }
+}
+
+ENetPacket* SnapshotEncoder::Create(const proto::ObjectsVector& vector, bool reliable) {
+    return Pool_.Create(vector, reliable ? ENET_PACKET_FLAG_RELIABLE : (ENET_PACKET_FLAG_UNRELIABLE_FRAGMENT | ENET_PACKET_FLAG_UNSEQUENCED));
+}
@@ -0,0 +1,48 @@
+#pragma once
+
+#include <core/packet_pool.h>
+#include <core/replication.h>
+#include <core/thread_pool.h>
+#include <core/world.h>
+
+#include <cstdint>
+#include <future>
+#include <vector>
+
+struct SnapshotJob {
+    uint32_t Peer;
+    PeerReplication* Replication;
+    // Filled by Encode, in order. Empty if the peer has nothing to receive this time.
+    std::vector<ENetPacket*> Packets = {};
+};
+
+// Encodes per-peer snapshots on worker threads. Jobs are split into one batch per
+// worker, each job's replication state is only touched by the worker encoding it
+// and the packets are handed back for the caller to send in one go.
+// Snapshots larger than maxPacketSize, like a late joiner's baseline, are split into
+// packets that fit, so they are neither fragmented nor block a channel as one message.
+class SnapshotEncoder {
+public:
+    // ENet's default MTU is 1400 bytes including its headers.
+    explicit SnapshotEncoder(PacketPool& pool, size_t threads = std::thread::hardware_concurrency(), size_t maxPacketSize = 1200);
+
+    // Encodes every job against world and blocks until all are done. World must not
+    // change meanwhile, the server encodes from a copy published at broadcast time.
+    void Encode(const World& world, const ReplicationConfig& config, uint64_t serverTime, std::vector<SnapshotJob>& jobs);
+
+    size_t GetThreads() const {
+        return Threads_;
+    }
+
+private:
+    void EncodeRange(const World& world, const ReplicationConfig& config, uint64_t serverTime, SnapshotJob* begin, SnapshotJob* end);
+    void Split(const proto::ObjectsVector& vector, size_t creations, SnapshotJob& job);
+    ENetPacket* Create(const proto::ObjectsVector& vector, bool reliable);
+
+private:
+    PacketPool& Pool_;
+    size_t Threads_;
+    size_t MaxPacketSize_;
+    ThreadPool Workers_;
+    std::vector<std::future<void>> Batches_;
+};
@@ -0,0 +1,283 @@
+#include <core/terrain.h>
+#include <core/terrain_edit.h>
+#include <core/simplex.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+float TerrainVolume::Sample(const glm::vec3& p) const {
+    return Height(p.x, p.z) + - p.y / 10.0f;
+}
+
+float TerrainVolume::Height(float x, float z) const {
+    return
+        Simplex::noise(glm::vec4(x / 20, 0, z / 20, Time_ / 3.0f)) * 0.7f +
+        Simplex::noise(glm::vec4(x / 10, 0, z / 10, Time_ / 3.0f)) * 0.3f;
+}
+
+glm::vec3 TerrainVolume::Normal(const glm::vec3& p, float d) const {
+    return -glm::normalize(glm::vec3(
+        Sample(glm::vec3(p.x + d, p.y, p.z)) - Sample(glm::vec3(p.x - d, p.y, p.z)),
+        Sample(glm::vec3(p.x, p.y + d, p.z)) - Sample(glm::vec3(p.x, p.y - d, p.z)),
+        Sample(glm::vec3(p.x, p.y, p.z + d)) - Sample(glm::vec3(p.x, p.y, p.z - d))));
+}
+
+void TerrainVolume::SampleBlock(const glm::ivec3& origin, const glm::ivec3& size, float* values, glm::vec3* normals) const {
+    const float d = 0.01f;
+
+    for (int x = 0; x < size.x; ++x) {
+        for (int z = 0; z < size.z; ++z) {
+            const float px = (float)(origin.x + x);
+            const float pz = (float)(origin.z + z);
+            const float height = Height(px, pz);
+
+            // Central differences like Normal, the y derivative of the linear term is exact.
+            glm::vec3 gradient(0.0f);
+            if (normals) {
+                gradient.x = Height(px + d, pz) - Height(px - d, pz);
+                gradient.z = Height(px, pz + d) - Height(px, pz - d);
+            }
+
+            for (int y = 0; y < size.y; ++y) {
+                const float py = (float)(origin.y + y);
+                const size_t index = ((size_t)x * size.y + y) * size.z + z;
+                values[index] = height + - py / 10.0f;
+                if (normals) {
+                    gradient.y = - (py + d) / 10.0f - - (py - d) / 10.0f;
+                    normals[index] = -glm::normalize(gradient);
+                }
+            }
+        }
+    }
+}
+
+void TerrainChunk::Generate(const TerrainVolume& volume, const glm::ivec3& coord) {
+    Coord = coord;
+    EditSequence = 0;
+    Values.resize(Samples * Samples * Samples);
+    Materials.assign(Samples * Samples * Samples, 0);
+
+    volume.SampleBlock(coord * Size, glm::ivec3(Samples), Values.data());
+}
+
+namespace {
+
+// PackBits: a header byte n < 128 is followed by n + 1 literal bytes,
+// n >= 128 by a single byte repeated n - 126 times.
+void pack_bits(const uint8_t* data, size_t size, std::string& out) {
+    size_t i = 0;
+    while (i < size) {
+        size_t run = 1;
+        while (i + run < size && run < 129 && data[i + run] == data[i]) {
+            ++run;
+        }
+
+        if (run >= 2) {
+            out.push_back((char)(run + 126));
+            out.push_back((char)data[i]);
+            i += run;
+            continue;
+        }
+
+        size_t literal = 1;
+        while (i + literal < size && literal < 128 &&
+               (i + literal + 1 >= size || data[i + literal] != data[i + literal + 1])) {
+            ++literal;
+        }
+
+        out.push_back((char)(literal - 1));
+        out.append((const char*)&data[i], literal);
+        i += literal;
+    }
+}
+
+// Decodes exactly size bytes starting at data[pos], advancing pos.
+bool unpack_bits(const std::string& data, size_t& pos, uint8_t* out, size_t size) {
+    size_t written = 0;
+    while (written < size) {
+        if (pos >= data.size()) {
+            return false;
+        }
+
+        uint8_t header = (uint8_t)data[pos++];
+        if (header < 128) {
+            size_t literal = header + 1;
+            if (pos + literal > data.size() || written + literal > size) {
+                return false;
+            }
+            memcpy(out + written, data.data() + pos, literal);
+            pos += literal;
+            written += literal;
+        } else {
+            size_t run = header - 126;
+            if (pos >= data.size() || written + run > size) {
+                return false;
+            }
+            memset(out + written, (uint8_t)data[pos++], run);
+            written += run;
+        }
+    }
+    return true;
+}
+
+}
+
+void TerrainChunk::Compress(std::string& out) const {
+    std::vector<uint8_t> quantized(Values.size());
+    for (size_t i = 0; i < Values.size(); ++i) {
+        quantized[i] = (uint8_t)(int8_t)std::lround(std::clamp(Values[i] / Range, -1.0f, 1.0f) * 127.0f);
+    }
+
+    out.clear();
+    pack_bits(quantized.data(), quantized.size(), out);
+    pack_bits(Materials.data(), Materials.size(), out);
+}
+
+bool TerrainChunk::Decompress(const glm::ivec3& coord, const std::string& data) {
+    Coord = coord;
+    Values.resize(Samples * Samples * Samples);
+    Materials.resize(Samples * Samples * Samples);
+
+    std::vector<uint8_t> quantized(Values.size());
+    size_t pos = 0;
+    if (!unpack_bits(data, pos, quantized.data(), quantized.size()) ||
+        !unpack_bits(data, pos, Materials.data(), Materials.size()) ||
+        pos != data.size()) {
+        return false;
+    }
+
+    for (size_t i = 0; i < Values.size(); ++i) {
+        Values[i] = (int8_t)quantized[i] / 127.0f * Range;
+    }
+    return true;
+}
+
+const TerrainChunkCache::Entry& TerrainChunkCache::Get(const glm::ivec3& coord) {
+    auto it = Entries_.find(coord);
+    if (it == Entries_.end()) {
+        auto entry = std::make_unique<Entry>();
+        entry->Chunk.Generate(Volume_, coord);
+        if (Edits_) {
+            Edits_->ApplyToChunk(entry->Chunk);
+        }
+        entry->Chunk.Compress(entry->Compressed);
+        ++Generated_;
+
+        const std::unique_lock<std::mutex> guard = Lock();
+        it = Entries_.emplace(coord, std::move(entry)).first;
+    }
+    it->second->LastUse = ++Clock_;
+
+    const Entry& result = *it->second;
+    if (Entries_.size() > Capacity_) {
+        const std::unique_lock<std::mutex> guard = Lock();
+        Evict();
+    }
+    return result;
+}
+
+void TerrainChunkCache::Refresh() {
+    if (!Edits_ || Sequence_ == Edits_->GetSequence()) {
+        return;
+    }
+
+    std::unordered_set<glm::ivec3> dirty;
+    std::vector<glm::ivec3> chunks;
+    auto [begin, end] = Edits_->GetEditsSince(Sequence_);
+    {
+        // Other threads may be sampling the chunks being edited.
+        const std::unique_lock<std::mutex> guard = Lock();
+        for (auto edit = begin; edit != end; ++edit) {
+            chunks.clear();
+            edit->GetAffectedChunks(chunks);
+            for (const glm::ivec3& coord : chunks) {
+                auto it = Entries_.find(coord);
+                if (it != Entries_.end() && it->second->Chunk.EditSequence < edit->Sequence) {
+                    edit->ApplyToChunk(it->second->Chunk);
+                    dirty.insert(coord);
+                }
+            }
+        }
+    }
+
+    // Only this thread reads the compressed forms.
+    for (const glm::ivec3& coord : dirty) {
+        Entry& entry = *Entries_.at(coord);
+        entry.Chunk.EditSequence = Edits_->GetSequence();
+        entry.Chunk.Compress(entry.Compressed);
+    }
+
+    Sequence_ = Edits_->GetSequence();
+}
+
+void TerrainChunkCache::Evict() {
+    // Drop the least recently used eighth at once so eviction cost is amortized.
+    std::vector<uint64_t> uses;
+    uses.reserve(Entries_.size());
+    for (const auto& [coord, entry] : Entries_) {
+        uses.push_back(entry->LastUse);
+    }
+
+    auto nth = uses.begin() + uses.size() / 8;
+    std::nth_element(uses.begin(), nth, uses.end());
+    uint64_t threshold = *nth;
+
+    std::erase_if(Entries_, [threshold, this](const auto& item) {
+        return item.second->LastUse < threshold && item.second->LastUse != Clock_;
+    });
+}
+
+TerrainStreamer::TerrainStreamer(const TerrainStreamConfig& config)
+    : Config_(config)
+{
+    for (int x = -config.Radius; x <= config.Radius; ++x) {
+        for (int z = -config.Radius; z <= config.Radius; ++z) {
+            if (x * x + z * z > config.Radius * config.Radius) {
+                continue;
+            }
+            for (int y = config.MinY; y <= config.MaxY; ++y) {
+                Offsets_.emplace_back(x, y, z);
+            }
+        }
+    }
+
+    std::stable_sort(Offsets_.begin(), Offsets_.end(), [](const glm::ivec3& a, const glm::ivec3& b) {
+        return a.x * a.x + a.z * a.z < b.x * b.x + b.z * b.z;
+    });
+}
+
+void TerrainStreamer::Collect(const glm::vec3& focus, TerrainChunkCache& cache, std::vector<const TerrainChunkCache::Entry*>& out) {
+    glm::ivec3 center = TerrainChunk::ToChunk(focus);
+    center.y = 0;
+
+    // Forget chunks well outside the view range, the client evicts them too.
+    if (center != LastCenter_) {
+        LastCenter_ = center;
+        int keep = Config_.Radius + 2;
+        std::erase_if(Sent_, [&center, keep](const glm::ivec3& coord) {
+            glm::ivec2 d(coord.x - center.x, coord.z - center.z);
+            return d.x * d.x + d.y * d.y > keep * keep;
+        });
+    }
+
+    size_t budget = Config_.BytesPerTick;
+    for (const glm::ivec3& offset : Offsets_) {
+        glm::ivec3 coord(center.x + offset.x, offset.y, center.z + offset.z);
+        if (Sent_.contains(coord)) {
+            continue;
+        }
+
+        const TerrainChunkCache::Entry& entry = cache.Get(coord);
+        if (entry.Compressed.size() > budget && !out.empty()) {
+            break;
+        }
+
+        Sent_.insert(coord);
+        out.push_back(&entry);
+        if (entry.Compressed.size() >= budget) {
+            break;
+        }
+        budget -= entry.Compressed.size();
+    }
+}
@@ -0,0 +1,175 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <glm/gtx/hash.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Terrain density field shared by the server and clients.
+// Positive inside solid terrain, negative in air, the surface is the zero level set.
+class TerrainVolume {
+public:
+    float Sample(const glm::vec3& p) const;
+
+    // Outward surface normal, the negated normalized density gradient.
+    glm::vec3 Normal(const glm::vec3& p, float d = 0.01f) const;
+
+    // Samples size.x * size.y * size.z lattice points with unit spacing from origin into
+    // values, x-major like TerrainChunk, and their normals if not null. Values equal Sample's,
+    // normals Normal's up to rounding, but the noise is evaluated once per column, not per point.
+    void SampleBlock(const glm::ivec3& origin, const glm::ivec3& size, float* values, glm::vec3* normals = nullptr) const;
+
+    // Only used to animate the field in the client demo, the server keeps it at zero.
+    float GetTime() const {
+        return Time_;
+    }
+
+    void SetTime(float time) {
+        Time_ = time;
+    }
+
+private:
+    // Noise part of the density, it does not depend on y.
+    float Height(float x, float z) const;
+
+private:
+    float Time_ = 0.0f;
+};
+
+// Density samples of one chunk: (Size + 1)^3 lattice points starting at Coord * Size,
+// so a chunk can be meshed without its neighbours.
+struct TerrainChunk {
+    static constexpr int Size = 16;
+    static constexpr int Samples = Size + 1;
+    // Densities are clamped to [-Range, Range] and quantized to 8 bits for transfer,
+    // only the sign and values close to the surface matter for meshing.
+    static constexpr float Range = 0.5f;
+
+    glm::ivec3 Coord = glm::ivec3(0);
+    std::vector<float> Values;
+    std::vector<uint8_t> Materials;
+    // Sequence number of the last terrain edit applied to this chunk.
+    uint32_t EditSequence = 0;
+
+    static size_t Index(int x, int y, int z) {
+        return (x * Samples + y) * Samples + z;
+    }
+
+    float& At(int x, int y, int z) {
+        return Values[Index(x, y, z)];
+    }
+
+    float At(int x, int y, int z) const {
+        return Values[Index(x, y, z)];
+    }
+
+    glm::vec3 GetOrigin() const {
+        return glm::vec3(Coord * Size);
+    }
+
+    void Generate(const TerrainVolume& volume, const glm::ivec3& coord);
+
+    // Quantized, run-length encoded densities followed by run-length encoded materials.
+    void Compress(std::string& out) const;
+    bool Decompress(const glm::ivec3& coord, const std::string& data);
+
+    static glm::ivec3 ToChunk(const glm::vec3& p) {
+        return glm::ivec3(glm::floor(p / (float)Size));
+    }
+};
+
+class TerrainEditLog;
+
+// Chunks generated on demand with all logged edits applied and kept with their
+// compressed form, least recently used ones are evicted. Get, Refresh and the edit log
+// belong to one thread. With a lock, chunks are built outside of it and it is only held
+// while entries change, other threads may Find resident chunks under the same lock.
+class TerrainChunkCache {
+public:
+    struct Entry {
+        TerrainChunk Chunk;
+        std::string Compressed;
+        uint64_t LastUse = 0;
+    };
+
+    explicit TerrainChunkCache(const TerrainVolume& volume, const TerrainEditLog* edits = nullptr, size_t capacity = 4096, std::mutex* lock = nullptr)
+        : Volume_(volume)
+        , Edits_(edits)
+        , Capacity_(capacity)
+        , Lock_(lock)
+    {}
+
+    const Entry& Get(const glm::ivec3& coord);
+
+    // Resident chunk or null, never generates.
+    const Entry* Find(const glm::ivec3& coord) const {
+        auto it = Entries_.find(coord);
+        return it != Entries_.end() ? it->second.get() : nullptr;
+    }
+
+    // Applies edits appended to the log since the cached chunks were built. Only
+    // chunks overlapping the edits are touched and recompressed.
+    void Refresh();
+
+    size_t Size() const {
+        return Entries_.size();
+    }
+
+    uint64_t GetGenerated() const {
+        return Generated_;
+    }
+
+private:
+    void Evict();
+
+    std::unique_lock<std::mutex> Lock() const {
+        return Lock_ ? std::unique_lock<std::mutex>(*Lock_) : std::unique_lock<std::mutex>();
+    }
+
+private:
+    const TerrainVolume& Volume_;
+    const TerrainEditLog* Edits_;
+    size_t Capacity_;
+    std::mutex* Lock_;
+    std::unordered_map<glm::ivec3, std::unique_ptr<Entry>> Entries_;
+    uint64_t Clock_ = 0;
+    uint64_t Generated_ = 0;
+    uint32_t Sequence_ = 0;
+};
+
+struct TerrainStreamConfig {
+    // Horizontal view distance in chunks.
+    int Radius = 6;
+    // Vertical chunk range that can contain the surface.
+    int MinY = -2;
+    int MaxY = 1;
+    // Compressed bytes sent to one peer per tick, keeps terrain from starving snapshots.
+    size_t BytesPerTick = 16 * 1024;
+};
+
+// Per-peer terrain streaming state: which chunks the peer has, and which to send
+// next, nearest to the focus point first.
+class TerrainStreamer {
+public:
+    explicit TerrainStreamer(const TerrainStreamConfig& config);
+
+    // Appends chunks to send this tick to out, in priority order, within the byte budget.
+    void Collect(const glm::vec3& focus, TerrainChunkCache& cache, std::vector<const TerrainChunkCache::Entry*>& out);
+
+    size_t GetSentChunks() const {
+        return Sent_.size();
+    }
+
+private:
+    TerrainStreamConfig Config_;
+    // Chunk offsets within the view range sorted by distance.
+    std::vector<glm::ivec3> Offsets_;
+    std::unordered_set<glm::ivec3> Sent_;
+    glm::ivec3 LastCenter_ = glm::ivec3(0);
+};
@@ -0,0 +1,120 @@
+#include <core/terrain_collision.h>
+
+#include <algorithm>
+#include <cmath>
+#include <tuple>
+
+size_t TerrainCollider::Collide(World& world) {
+    Bodies_.clear();
+    for (const auto& [id, object] : world.GetObjects()) {
+        if (object.velocity.isZero() || !world.IsSimulated(id)) {
+            continue;
+        }
+
+        Object* target = world.Find(id);
+        glm::vec3 p(object.position.x(), Config_.Height, object.position.y());
+        Bodies_.push_back(Body { target, TerrainChunk::ToChunk(p) });
+    }
+
+    // Group bodies by chunk so every chunk is looked up once per tick.
+    std::sort(Bodies_.begin(), Bodies_.end(), [](const Body& a, const Body& b) {
+        return std::tie(a.Chunk.x, a.Chunk.y, a.Chunk.z) < std::tie(b.Chunk.x, b.Chunk.y, b.Chunk.z);
+    });
+
+    size_t pushed = 0;
+    const TerrainChunk* chunk = nullptr;
+    for (const Body& body : Bodies_) {
+        Object& object = *body.Target;
+        bool hit = false;
+        for (int i = 0; i < Config_.Iterations; ++i) {
+            glm::vec3 p(object.position.x(), Config_.Height, object.position.y());
+            // Consecutive bodies mostly share a chunk, a push may also cross into a neighbour.
+            glm::ivec3 coord = TerrainChunk::ToChunk(p);
+            if (!chunk || chunk->Coord != coord) {
+                const TerrainChunkCache::Entry* entry = Cache_.Find(coord);
+                chunk = entry ? &entry->Chunk : nullptr;
+            }
+            if (!chunk) {
+                break;
+            }
+
+            glm::vec3 gradient;
+            float value = Sample(*chunk, p, gradient);
+            glm::vec2 planar(gradient.x, gradient.z);
+            float slope = glm::length(planar);
+            if (slope < 1e-6f) {
+                break;
+            }
+
+            // Positive density is solid. The push is planar, so the distance to the surface
+            // along it is value over the planar gradient length, not the full one.
+            float depth = value / slope + Config_.Radius;
+            if (depth <= 0.0f) {
+                break;
+            }
+
+            // Outward direction in the movement plane.
+            Eigen::Vector2f normal(-planar.x / slope, -planar.y / slope);
+            object.position += normal * depth;
+            float into = object.velocity.dot(normal);
+            if (into < 0.0f) {
+                object.velocity -= normal * into;
+            }
+            hit = true;
+        }
+
+        pushed += hit;
+    }
+
+    return pushed;
+}
+
+void TerrainCollider::Prefetch(const World& world) {
+    Occupied_.clear();
+    for (const auto& [id, object] : world.GetObjects()) {
+        if (!object.velocity.isZero() && world.IsSimulated(id)) {
+            Occupied_.insert(TerrainChunk::ToChunk(glm::vec3(object.position.x(), Config_.Height, object.position.y())));
+        }
+    }
+
+    // Neighbours too, objects cross chunk borders between prefetches and pushes cross them as well.
+    for (const glm::ivec3& coord : Occupied_) {
+        for (int dx = -1; dx <= 1; ++dx) {
+            for (int dz = -1; dz <= 1; ++dz) {
+                Cache_.Get(coord + glm::ivec3(dx, 0, dz));
+            }
+        }
+    }
+}
+
+float TerrainCollider::Sample(const TerrainChunk& chunk, const glm::vec3& p, glm::vec3& gradient) {
+    glm::vec3 local = p - chunk.GetOrigin();
+    glm::ivec3 cell = glm::clamp(glm::ivec3(glm::floor(local)), glm::ivec3(0), glm::ivec3(TerrainChunk::Size - 1));
+    glm::vec3 t = glm::clamp(local - glm::vec3(cell), 0.0f, 1.0f);
+
+    float c[2][2][2];
+    for (int dx = 0; dx < 2; ++dx) {
+        for (int dy = 0; dy < 2; ++dy) {
+            for (int dz = 0; dz < 2; ++dz) {
+                c[dx][dy][dz] = chunk.At(cell.x + dx, cell.y + dy, cell.z + dz);
+            }
+        }
+    }
+
+    float x00 = glm::mix(c[0][0][0], c[1][0][0], t.x);
+    float x01 = glm::mix(c[0][0][1], c[1][0][1], t.x);
+    float x10 = glm::mix(c[0][1][0], c[1][1][0], t.x);
+    float x11 = glm::mix(c[0][1][1], c[1][1][1], t.x);
+    float y0 = glm::mix(x00, x10, t.y);
+    float y1 = glm::mix(x01, x11, t.y);
+
+    // Analytic derivatives of the trilinear interpolant.
+    auto lerp2 = [](float a, float b, float c, float d, float u, float v) {
+        return glm::mix(glm::mix(a, b, u), glm::mix(c, d, u), v);
+    };
+    gradient.x = lerp2(c[1][0][0] - c[0][0][0], c[1][1][0] - c[0][1][0], c[1][0][1] - c[0][0][1], c[1][1][1] - c[0][1][1], t.y, t.z);
+    gradient.y = lerp2(c[0][1][0] - c[0][0][0], c[1][1][0] - c[1][0][0], c[0][1][1] - c[0][0][1], c[1][1][1] - c[1][0][1], t.x, t.z);
+    gradient.z = y1 - y0;
+
+    return glm::mix(y0, y1, t.z);
+}
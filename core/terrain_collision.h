@@ -0,0 +1,52 @@
+#pragma once
+
+#include <core/terrain.h>
+#include <core/world.h>
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+
+struct TerrainCollisionConfig {
+    // Objects are discs of this radius moving in the horizontal plane at Height.
+    float Radius = 0.5f;
+    float Height = 0.0f;
+    int Iterations = 2;
+};
+
+// Collides objects directly against the terrain density field, no collision meshes.
+// The field is sampled by trilinear interpolation of cached chunk lattices; the
+// density over its planar gradient length approximates the distance to the surface
+// in the movement plane, objects inside are pushed out along that gradient.
+// Collide never generates chunks, Prefetch loads them on the thread owning the cache.
+class TerrainCollider {
+public:
+    TerrainCollider(TerrainChunkCache& cache, const TerrainCollisionConfig& config = {})
+        : Cache_(cache)
+        , Config_(config)
+    {}
+
+    // Resolves penetration of every simulated moving object. Objects outside resident
+    // chunks are left alone until their chunks are prefetched. Returns the number of objects pushed.
+    size_t Collide(World& world);
+
+    // Loads the chunks around every moving object of world, a recent copy of the simulated one.
+    void Prefetch(const World& world);
+
+    // Trilinear density at p within chunk and its gradient.
+    static float Sample(const TerrainChunk& chunk, const glm::vec3& p, glm::vec3& gradient);
+
+private:
+    struct Body {
+        Object* Target;
+        glm::ivec3 Chunk;
+    };
+
+    TerrainChunkCache& Cache_;
+    TerrainCollisionConfig Config_;
+    // Reused between ticks so the batch does not allocate in steady state.
+    std::vector<Body> Bodies_;
+    std::unordered_set<glm::ivec3> Occupied_;
+};
@@ -0,0 +1,187 @@
+#include <core/terrain_edit.h>
+
+#include <cmath>
+#include <unordered_set>
+
+float TerrainEdit::Apply(const glm::vec3& p, float value, uint8_t& material) const {
+    glm::vec3 d = p - Center;
+
+    // Signed distance, positive inside the shape.
+    float inside;
+    if (EditShape == Shape::Sphere) {
+        inside = Size.x - glm::length(d);
+    } else {
+        glm::vec3 q = glm::abs(d) - Size;
+        inside = -(glm::length(glm::max(q, 0.0f)) + std::min(std::max(q.x, std::max(q.y, q.z)), 0.0f));
+    }
+
+    if (inside < -Margin) {
+        return value;
+    }
+
+    float density = inside * DensityScale;
+    if (EditOperation == Operation::Add) {
+        if (density >= 0.0f) {
+            material = Material;
+        }
+        return std::max(value, density);
+    }
+    return std::min(value, -density);
+}
+
+void TerrainEdit::ApplyToChunk(TerrainChunk& chunk) const {
+    glm::vec3 low, high;
+    GetBounds(low, high);
+
+    glm::ivec3 origin = chunk.Coord * TerrainChunk::Size;
+    glm::ivec3 from = glm::max(glm::ivec3(glm::ceil(low)) - origin, glm::ivec3(0));
+    glm::ivec3 to = glm::min(glm::ivec3(glm::floor(high)) - origin, glm::ivec3(TerrainChunk::Size));
+
+    for (int x = from.x; x <= to.x; ++x) {
+        for (int y = from.y; y <= to.y; ++y) {
+            for (int z = from.z; z <= to.z; ++z) {
+                size_t i = TerrainChunk::Index(x, y, z);
+                chunk.Values[i] = Apply(glm::vec3(origin + glm::ivec3(x, y, z)), chunk.Values[i], chunk.Materials[i]);
+            }
+        }
+    }
+
+    chunk.EditSequence = std::max(chunk.EditSequence, Sequence);
+}
+
+void TerrainEdit::GetBounds(glm::vec3& low, glm::vec3& high) const {
+    glm::vec3 extent = (EditShape == Shape::Sphere ? glm::vec3(Size.x) : Size) + Margin;
+    low = Center - extent;
+    high = Center + extent;
+}
+
+void TerrainEdit::GetAffectedChunks(std::vector<glm::ivec3>& out) const {
+    glm::vec3 low, high;
+    GetBounds(low, high);
+
+    // Chunk c owns lattice points [c * Size, c * Size + Size], borders are shared.
+    glm::ivec3 from = glm::ivec3(glm::ceil(low / (float)TerrainChunk::Size - 1.0f));
+    glm::ivec3 to = glm::ivec3(glm::floor(high / (float)TerrainChunk::Size));
+
+    for (int x = from.x; x <= to.x; ++x) {
+        for (int y = from.y; y <= to.y; ++y) {
+            for (int z = from.z; z <= to.z; ++z) {
+                out.emplace_back(x, y, z);
+            }
+        }
+    }
+}
+
+void TerrainEdit::Encode(proto::TerrainEdit* edit) const {
+    edit->set_sequence(Sequence);
+    edit->set_shape(EditShape == Shape::Sphere ? proto::TerrainEdit::SPHERE : proto::TerrainEdit::BOX);
+    edit->set_operation(EditOperation == Operation::Add ? proto::TerrainEdit::ADD : proto::TerrainEdit::SUBTRACT);
+    edit->mutable_center()->set_x(Center.x);
+    edit->mutable_center()->set_y(Center.y);
+    edit->mutable_center()->set_z(Center.z);
+    edit->mutable_size()->set_x(Size.x);
+    edit->mutable_size()->set_y(Size.y);
+    edit->mutable_size()->set_z(Size.z);
+    edit->set_material(Material);
+}
+
+bool TerrainEdit::Decode(const proto::TerrainEdit& edit, TerrainEdit& out) {
+    switch (edit.shape()) {
+        case proto::TerrainEdit::SPHERE: out.EditShape = Shape::Sphere; break;
+        case proto::TerrainEdit::BOX: out.EditShape = Shape::Box; break;
+        default: return false;
+    }
+
+    switch (edit.operation()) {
+        case proto::TerrainEdit::ADD: out.EditOperation = Operation::Add; break;
+        case proto::TerrainEdit::SUBTRACT: out.EditOperation = Operation::Subtract; break;
+        default: return false;
+    }
+
+    out.Sequence = edit.sequence();
+    out.Center = glm::vec3(edit.center().x(), edit.center().y(), edit.center().z());
+    out.Size = glm::clamp(glm::vec3(edit.size().x(), edit.size().y(), edit.size().z()), 0.0f, MaxSize);
+    out.Material = (uint8_t)std::min<uint32_t>(edit.material(), 255);
+
+    // Comparisons with NaN fail, non finite values are rejected as well.
+    auto within = [](const glm::vec3& v, float limit) {
+        return std::abs(v.x) <= limit && std::abs(v.y) <= limit && std::abs(v.z) <= limit;
+    };
+    return within(out.Center, MaxCoordinate) && within(out.Size, MaxSize);
+}
+
+const TerrainEdit& TerrainEditLog::Append(TerrainEdit edit) {
+    edit.Sequence = ++Sequence_;
+    Edits_.push_back(edit);
+    Index(Edits_.back());
+    return Edits_.back();
+}
+
+void TerrainEditLog::Index(const TerrainEdit& edit) {
+    std::vector<glm::ivec3> chunks;
+    edit.GetAffectedChunks(chunks);
+    for (const glm::ivec3& coord : chunks) {
+        ChunkEdits_[coord].push_back(edit.Sequence);
+    }
+}
+
+void TerrainEditLog::ApplyToChunk(TerrainChunk& chunk) const {
+    auto baseline = Baselines_.find(chunk.Coord);
+    if (baseline != Baselines_.end() && baseline->second.Sequence > chunk.EditSequence) {
+        chunk.Decompress(chunk.Coord, baseline->second.Compressed);
+        chunk.EditSequence = baseline->second.Sequence;
+    }
+
+    auto it = ChunkEdits_.find(chunk.Coord);
+    if (it != ChunkEdits_.end()) {
+        for (uint32_t sequence : it->second) {
+            if (sequence > chunk.EditSequence) {
+                Get(sequence).ApplyToChunk(chunk);
+            }
+        }
+    }
+
+    chunk.EditSequence = GetSequence();
+}
+
+void TerrainEditLog::Compact(const TerrainVolume& volume, uint32_t sequence) {
+    sequence = std::min(sequence, Sequence_);
+    if (sequence <= Compacted_) {
+        return;
+    }
+
+    std::unordered_set<glm::ivec3> touched;
+    std::vector<glm::ivec3> chunks;
+    for (uint32_t i = Compacted_ + 1; i <= sequence; ++i) {
+        chunks.clear();
+        Get(i).GetAffectedChunks(chunks);
+        touched.insert(chunks.begin(), chunks.end());
+    }
+
+    TerrainChunk chunk;
+    for (const glm::ivec3& coord : touched) {
+        chunk.Generate(volume, coord);
+        auto baseline = Baselines_.find(coord);
+        if (baseline != Baselines_.end()) {
+            chunk.Decompress(coord, baseline->second.Compressed);
+            chunk.EditSequence = baseline->second.Sequence;
+        }
+        for (uint32_t i : ChunkEdits_.at(coord)) {
+            if (i > chunk.EditSequence && i <= sequence) {
+                Get(i).ApplyToChunk(chunk);
+            }
+        }
+
+        Baseline& result = Baselines_[coord];
+        result.Sequence = sequence;
+        chunk.Compress(result.Compressed);
+    }
+
+    Edits_.erase(Edits_.begin(), Edits_.begin() + (sequence - Compacted_));
+    Compacted_ = sequence;
+
+    ChunkEdits_.clear();
+    for (const TerrainEdit& edit : Edits_) {
+        Index(edit);
+    }
+}
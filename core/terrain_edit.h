@@ -0,0 +1,114 @@
+#pragma once
+
+#include <core/terrain.h>
+
+#include <object.pb.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtx/hash.hpp>
+
+#include <algorithm>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// CSG edit of the terrain density field.
+struct TerrainEdit {
+    enum class Shape : uint8_t {
+        Sphere,
+        Box,
+    };
+
+    enum class Operation : uint8_t {
+        Add,
+        Subtract,
+    };
+
+    // Edit distances are scaled to the slope of TerrainVolume so edited and
+    // generated densities quantize the same way.
+    static constexpr float DensityScale = 0.1f;
+    static constexpr float MaxSize = 16.0f;
+    // Edits centered further out are rejected, chunk coordinates stay well inside int range.
+    static constexpr float MaxCoordinate = 1000000.0f;
+    // Beyond this distance from the shape densities saturate when quantized, so the
+    // edit is limited to its bounds grown by it. This keeps edits chunk local.
+    static constexpr float Margin = TerrainChunk::Range / DensityScale;
+
+    uint32_t Sequence = 0;
+    Shape EditShape = Shape::Sphere;
+    Operation EditOperation = Operation::Add;
+    glm::vec3 Center = glm::vec3(0);
+    // Radius in x for spheres, half extents for boxes.
+    glm::vec3 Size = glm::vec3(1);
+    uint8_t Material = 0;
+
+    // Returns the edited density at p, updating material where solid is added.
+    float Apply(const glm::vec3& p, float value, uint8_t& material) const;
+    void ApplyToChunk(TerrainChunk& chunk) const;
+
+    void GetBounds(glm::vec3& low, glm::vec3& high) const;
+    // Chunks whose lattice points the edit may change.
+    void GetAffectedChunks(std::vector<glm::ivec3>& out) const;
+
+    void Encode(proto::TerrainEdit* edit) const;
+    // Rejects unknown enum values and centers beyond MaxCoordinate, clamps the size to MaxSize.
+    static bool Decode(const proto::TerrainEdit& edit, TerrainEdit& out);
+};
+
+// Ordered log of the edits applied to the terrain, indexed by chunk so that
+// generating a chunk only replays the edits that touch it. Compacting folds old
+// edits into compressed baselines of the chunks they touched, so the log stays
+// bounded by the edited area rather than the number of edits.
+class TerrainEditLog {
+public:
+    using Iterator = std::deque<TerrainEdit>::const_iterator;
+
+    // Assigns the next sequence number to the edit and appends it.
+    const TerrainEdit& Append(TerrainEdit edit);
+
+    // Applies edits with a sequence greater than chunk.EditSequence that overlap the chunk,
+    // starting from the chunk's baseline if it has one and is newer than the chunk.
+    void ApplyToChunk(TerrainChunk& chunk) const;
+
+    // Folds edits up to sequence into the baselines and drops them from the log. The volume
+    // must be the one chunks are generated from.
+    void Compact(const TerrainVolume& volume, uint32_t sequence);
+
+    uint32_t GetSequence() const {
+        return Sequence_;
+    }
+
+    // Edits still in the log, the ones after the last compaction.
+    size_t Size() const {
+        return Edits_.size();
+    }
+
+    // Edits with a sequence greater than since, sequences start at 1 and are dense.
+    // Edits folded into baselines are gone, since should not be older than the compaction.
+    std::pair<Iterator, Iterator> GetEditsSince(uint32_t since) const {
+        return { Edits_.begin() + std::min<size_t>(since - std::min(since, Compacted_), Edits_.size()), Edits_.end() };
+    }
+
+private:
+    struct Baseline {
+        uint32_t Sequence = 0;
+        std::string Compressed;
+    };
+
+    const TerrainEdit& Get(uint32_t sequence) const {
+        return Edits_[sequence - Compacted_ - 1];
+    }
+
+    void Index(const TerrainEdit& edit);
+
+private:
+    std::deque<TerrainEdit> Edits_;
+    // Sequences of the logged edits overlapping each chunk.
+    std::unordered_map<glm::ivec3, std::vector<uint32_t>> ChunkEdits_;
+    std::unordered_map<glm::ivec3, Baseline> Baselines_;
+    uint32_t Sequence_ = 0;
+    uint32_t Compacted_ = 0;
+};
@@ -0,0 +1,35 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+// Token bucket rate limiter: refills at Rate tokens per second up to Burst tokens,
+// every admitted event takes one. Times in nanoseconds on any monotonic clock.
+class TokenBucket {
+public:
+    TokenBucket(double rate, double burst)
+        : Rate_(rate)
+        , Burst_(burst)
+        , Tokens_(burst)
+    {}
+
+    // Returns false if the bucket is empty, the event should be dropped.
+    bool Take(uint64_t time) {
+        if (time > Last_) {
+            Tokens_ = std::min(Burst_, Tokens_ + (time - Last_) * 1e-9 * Rate_);
+        }
+        Last_ = std::max(Last_, time);
+
+        if (Tokens_ < 1.0) {
+            return false;
+        }
+        Tokens_ -= 1.0;
+        return true;
+    }
+
+private:
+    double Rate_;
+    double Burst_;
+    double Tokens_;
+    uint64_t Last_ = 0;
+};
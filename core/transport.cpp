@@ -0,0 +1,105 @@
+#include <core/transport.h>
+#include <core/channels.h>
+
+std::unique_ptr<EnetTransport> EnetTransport::Listen(uint16_t port, size_t maxPeers) {
+    if (enet_initialize() != 0) {
+        return nullptr;
+    }
+
+    ENetAddress address;
+    address.host = ENET_HOST_ANY;
+    address.port = port;
+
+    ENetHost* host = enet_host_create(&address, maxPeers, ChannelCount, 0, 0);
+    if (!host) {
+        enet_deinitialize();
+        return nullptr;
+    }
+    return std::unique_ptr<EnetTransport>(new EnetTransport(host));
+}
+
+std::unique_ptr<EnetTransport> EnetTransport::Connect(const char* host, uint16_t port, uint32_t data) {
+    if (enet_initialize() != 0) {
+        return nullptr;
+    }
+
+    ENetAddress address;
+    ENetHost* client = enet_host_create(nullptr, 1, ChannelCount, 0, 0);
+    if (!client || enet_address_set_host(&address, host) != 0) {
+        if (client) {
+            enet_host_destroy(client);
+        }
+        enet_deinitialize();
+        return nullptr;
+    }
+    address.port = port;
+
+    if (!enet_host_connect(client, &address, ChannelCount, data)) {
+        enet_host_destroy(client);
+        enet_deinitialize();
+        return nullptr;
+    }
+    return std::unique_ptr<EnetTransport>(new EnetTransport(client));
+}
+
+EnetTransport::~EnetTransport() {
+    enet_host_destroy(Host_);
+    enet_deinitialize();
+}
+
+bool EnetTransport::Service(std::vector<TransportEvent>& out, uint32_t timeout) {
+    ENetEvent event;
+    int result = enet_host_service(Host_, &event, timeout);
+    if (result <= 0) {
+        return result == 0;
+    }
+
+    // enet_host_service receives every pending datagram but dispatches one event,
+    // drain the rest so callers can handle the whole batch at once.
+    do {
+        TransportEvent translated;
+        if (Translate(event, translated)) {
+            out.push_back(translated);
+        }
+    } while (enet_host_check_events(Host_, &event) > 0);
+
+    return true;
+}
+
+bool EnetTransport::Translate(const ENetEvent& event, TransportEvent& out) const {
+    out.Peer = event.peer - Host_->peers;
+    out.Channel = event.channelID;
+    out.Data = event.data;
+    out.Packet = event.packet;
+
+    switch (event.type) {
+        case ENET_EVENT_TYPE_CONNECT:
+            out.Type = TransportEventType::Connect;
+            return true;
+        case ENET_EVENT_TYPE_DISCONNECT:
+            out.Type = TransportEventType::Disconnect;
+            return true;
+        case ENET_EVENT_TYPE_RECEIVE:
+            out.Type = TransportEventType::Receive;
+            return true;
+        default:
+            return false;
+    }
+}
+
+void EnetTransport::Send(uint32_t peer, uint8_t channel, ENetPacket* packet) {
+    // ENet leaves the packet to the caller when it refuses it.
+    if (peer >= Host_->peerCount || enet_peer_send(&Host_->peers[peer], channel, packet) < 0) {
+        enet_packet_destroy(packet);
+    }
+}
+
+void EnetTransport::Broadcast(uint8_t channel, ENetPacket* packet) {
+    enet_host_broadcast(Host_, channel, packet);
+}
+
+void EnetTransport::Disconnect(uint32_t peer) {
+    if (peer < Host_->peerCount) {
+        enet_peer_disconnect(&Host_->peers[peer], 0);
+    }
+}
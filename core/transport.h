@@ -0,0 +1,71 @@
+#pragma once
+
+#include <enet/enet.h>
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+enum class TransportEventType : uint8_t {
+    Connect,
+    Disconnect,
+    Receive
+};
+
+struct TransportEvent {
+    TransportEventType Type = TransportEventType::Receive;
+    // Transport specific peer handle, stable for the lifetime of the connection.
+    uint32_t Peer = 0;
+    uint8_t Channel = 0;
+    // Data sent with a connection request, zero if none.
+    uint32_t Data = 0;
+    // Received packet, owned by whoever handles the event and freed with enet_packet_destroy.
+    ENetPacket* Packet = nullptr;
+};
+
+// Message transport between the server and its clients. Packets are ENet packets
+// for every implementation so pooled buffers and reliability flags carry over.
+class ITransport {
+public:
+    virtual ~ITransport() = default;
+
+    // Waits up to timeout milliseconds for an event, then appends it and every other
+    // pending event to out. Returns false if the transport failed.
+    virtual bool Service(std::vector<TransportEvent>& out, uint32_t timeout) = 0;
+
+    // Queues a packet to a peer. Takes ownership of the packet, also when the peer is gone.
+    virtual void Send(uint32_t peer, uint8_t channel, ENetPacket* packet) = 0;
+
+    // Queues a packet to every connected peer. Takes ownership of the packet.
+    virtual void Broadcast(uint8_t channel, ENetPacket* packet) = 0;
+
+    virtual void Disconnect(uint32_t peer) = 0;
+};
+
+// UDP transport over an ENet host. Peer handles are slots in the host's peer array.
+class EnetTransport : public ITransport {
+public:
+    // Server host accepting up to maxPeers connections on port.
+    static std::unique_ptr<EnetTransport> Listen(uint16_t port, size_t maxPeers);
+
+    // Client host connecting to a server, which becomes peer 0 once the Connect event arrives.
+    // The server sees data in its Connect event.
+    static std::unique_ptr<EnetTransport> Connect(const char* host, uint16_t port, uint32_t data = 0);
+
+    ~EnetTransport() override;
+
+    bool Service(std::vector<TransportEvent>& out, uint32_t timeout) override;
+    void Send(uint32_t peer, uint8_t channel, ENetPacket* packet) override;
+    void Broadcast(uint8_t channel, ENetPacket* packet) override;
+    void Disconnect(uint32_t peer) override;
+
+private:
+    explicit EnetTransport(ENetHost* host)
+        : Host_(host)
+    {}
+
+    bool Translate(const ENetEvent& event, TransportEvent& out) const;
+
+private:
+    ENetHost* Host_;
+};
@@ -0,0 +1,100 @@
+#include <core/world.h>
+
+#include <algorithm>
+#include <cstdlib>
+
+Object& World::CreateObject() {
+    return CreateObject(NextId_++);
+}
+
+Object& World::CreateObject(uint32_t id) {
+    NextId_ = std::max(NextId_, id + 1);
+
+    Object& object = Objects_[id];
+    object.id = id;
+    object.color = Eigen::Vector3f((float)rand() / RAND_MAX, (float)rand() / RAND_MAX, (float)rand() / RAND_MAX);
+    object.position = Eigen::Vector2f::Zero();
+    object.velocity = Eigen::Vector2f::Zero();
+    object.rotation = 0.0f;
+    ObjectsToCreate_.emplace(id);
+    return object;
+}
+
+Object& World::AdoptObject(const Object& object) {
+    auto [it, created] = Objects_.insert_or_assign(object.id, object);
+    if (created) {
+        ObjectsToCreate_.emplace(object.id);
+    }
+    return it->second;
+}
+
+void World::RemoveObject(uint32_t id) {
+    if (Objects_.erase(id)) {
+        ObjectsToCreate_.erase(id);
+        NotSimulated_.erase(id);
+        ObjectsToDelete_.push_back(id);
+    }
+}
+
+void World::ApplyUserUpdate(uint32_t id, const proto::UserUpdate& update) {
+    Object* object = Find(id);
+    if (!object) {
+        return;
+    }
+
+    object->velocity = Eigen::Vector2f(std::clamp(update.velocity().x(), -1.0f, 1.0f), std::clamp(update.velocity().y(), -1.0f, 1.0f)) * 10.0f;
+    object->rotation = update.rotation();
+}
+
+void World::Step(float delta) {
+    for (auto& [id, object] : Objects_) {
+        if (!NotSimulated_.empty() && NotSimulated_.contains(id)) {
+            continue;
+        }
+        object.position += object.velocity * delta;
+    }
+
+    Time_ += delta;
+    ++Tick_;
+}
+
+bool World::EncodeSnapshot(proto::ObjectsVector& vector) const {
+    for (uint32_t id : ObjectsToDelete_) {
+        vector.add_objects_to_delete(id);
+    }
+    for (uint32_t id : ObjectsToCreate_) {
+        EncodeObject(Objects_.at(id), vector.add_objects());
+    }
+    for (const auto& [id, object] : Objects_) {
+        if (!ObjectsToCreate_.contains(id)) {
+            EncodeObject(object, vector.add_objects());
+        }
+    }
+
+    return !ObjectsToDelete_.empty() || !ObjectsToCreate_.empty();
+}
+
+void World::ClearPending() {
+    ObjectsToCreate_.clear();
+    ObjectsToDelete_.clear();
+}
+
+void World::EncodeObject(const Object& object, proto::Object* proto_object) {
+    proto_object->set_id(object.id);
+    proto_object->mutable_color()->set_r(object.color.x());
+    proto_object->mutable_color()->set_g(object.color.y());
+    proto_object->mutable_color()->set_b(object.color.z());
+    proto_object->mutable_position()->set_x(object.position.x());
+    proto_object->mutable_position()->set_y(object.position.y());
+    proto_object->mutable_velocity()->set_x(object.velocity.x());
+    proto_object->mutable_velocity()->set_y(object.velocity.y());
+    proto_object->set_rotation(object.rotation);
+}
+
+void World::DecodeObject(const proto::Object& proto_object, Object& object) {
+    object.id = proto_object.id();
+    object.color = Eigen::Vector3f(proto_object.color().r(), proto_object.color().g(), proto_object.color().b());
+    object.position = Eigen::Vector2f(proto_object.position().x(), proto_object.position().y());
+    object.velocity = Eigen::Vector2f(proto_object.velocity().x(), proto_object.velocity().y());
+    object.rotation = proto_object.rotation();
+}
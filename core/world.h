@@ -0,0 +1,92 @@
+#pragma once
+
+#include <core/object.h>
+
+#include <object.pb.h>
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+// Authoritative world state shared by the server and offline tools.
+// Not thread safe: callers serialize access (the server holds global_lock).
+class World {
+public:
+    Object& CreateObject();
+    Object& CreateObject(uint32_t id);
+    // Inserts or overwrites an object created elsewhere, keeping its id and state.
+    Object& AdoptObject(const Object& object);
+    void RemoveObject(uint32_t id);
+
+    // Ids handed out by CreateObject() continue from id. Zone servers use disjoint ranges.
+    void SetNextId(uint32_t id) {
+        NextId_ = id;
+    }
+
+    void ApplyUserUpdate(uint32_t id, const proto::UserUpdate& update);
+    // Moves every simulated object by its velocity.
+    void Step(float delta);
+
+    // Objects simulated elsewhere, like zone mirrors, are replicated but never stepped or
+    // collided here. Objects are simulated by default, removing one forgets the flag.
+    void SetSimulated(uint32_t id, bool simulated) {
+        if (simulated) {
+            NotSimulated_.erase(id);
+        } else {
+            NotSimulated_.insert(id);
+        }
+    }
+
+    bool IsSimulated(uint32_t id) const {
+        return !NotSimulated_.contains(id);
+    }
+
+    // Fills vector with pending deletions, then pending creations, then every other object.
+    // Returns true if the snapshot carries creations/deletions and must be sent reliably.
+    bool EncodeSnapshot(proto::ObjectsVector& vector) const;
+    void ClearPending();
+
+    static void EncodeObject(const Object& object, proto::Object* proto_object);
+    static void DecodeObject(const proto::Object& proto_object, Object& object);
+
+    Object* Find(uint32_t id) {
+        auto it = Objects_.find(id);
+        return it == Objects_.end() ? nullptr : &it->second;
+    }
+
+    const Object* Find(uint32_t id) const {
+        auto it = Objects_.find(id);
+        return it == Objects_.end() ? nullptr : &it->second;
+    }
+
+    const std::unordered_map<uint32_t, Object>& GetObjects() const {
+        return Objects_;
+    }
+
+    const std::vector<uint32_t>& GetObjectsToDelete() const {
+        return ObjectsToDelete_;
+    }
+
+    size_t Size() const {
+        return Objects_.size();
+    }
+
+    // Simulated time in seconds, advanced by Step.
+    double GetTime() const {
+        return Time_;
+    }
+
+    // Number of Step calls so far.
+    uint64_t GetTick() const {
+        return Tick_;
+    }
+
+private:
+    std::unordered_map<uint32_t, Object> Objects_;
+    std::vector<uint32_t> ObjectsToDelete_;
+    std::unordered_set<uint32_t> ObjectsToCreate_;
+    std::unordered_set<uint32_t> NotSimulated_;
+    uint32_t NextId_ = 1;
+    double Time_ = 0.0;
+    uint64_t Tick_ = 0;
+};
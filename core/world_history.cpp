@@ -0,0 +1,112 @@
+#include <core/world_history.h>
+
+#include <algorithm>
+#include <cmath>
+
+WorldHistory::WorldHistory(size_t frames, size_t maxObjects)
+    : MaxObjects_(maxObjects)
+    , Frames_(frames)
+    , Ids_(frames * maxObjects)
+    , X_(frames * maxObjects)
+    , Y_(frames * maxObjects)
+{
+    for (size_t i = 0; i < frames; ++i) {
+        Frames_[i].Offset = i * maxObjects;
+    }
+}
+
+void WorldHistory::Record(const World& world) {
+    Frame& frame = Frames_[Head_];
+    frame.Tick = world.GetTick();
+    frame.Count = 0;
+
+    uint32_t* ids = Ids_.data() + frame.Offset;
+    float* xs = X_.data() + frame.Offset;
+    float* ys = Y_.data() + frame.Offset;
+    for (const auto& [id, object] : world.GetObjects()) {
+        if (frame.Count == MaxObjects_) {
+            Dropped_ += world.Size() - MaxObjects_;
+            break;
+        }
+        ids[frame.Count] = id;
+        xs[frame.Count] = object.position.x();
+        ys[frame.Count] = object.position.y();
+        ++frame.Count;
+    }
+
+    Head_ = (Head_ + 1) % Frames_.size();
+    Count_ = std::min(Count_ + 1, Frames_.size());
+}
+
+uint64_t WorldHistory::GetOldestTick() const {
+    return Count_ ? Frames_[(Head_ + Frames_.size() - Count_) % Frames_.size()].Tick : 0;
+}
+
+uint64_t WorldHistory::GetNewestTick() const {
+    return Count_ ? Frames_[(Head_ + Frames_.size() - 1) % Frames_.size()].Tick : 0;
+}
+
+const WorldHistory::Frame* WorldHistory::Find(uint64_t tick) const {
+    if (Count_ == 0) {
+        return nullptr;
+    }
+
+    // Ticks are recorded consecutively, so the frame is found by offset from the newest.
+    uint64_t newest = GetNewestTick();
+    if (tick > newest || newest - tick >= Count_) {
+        return nullptr;
+    }
+
+    const Frame& frame = Frames_[(Head_ + Frames_.size() - 1 - (newest - tick)) % Frames_.size()];
+    return frame.Tick == tick ? &frame : nullptr;
+}
+
+bool WorldHistory::QueryRadius(uint64_t tick, const Eigen::Vector2f& center, float radius, std::vector<uint32_t>& out) const {
+    const Frame* frame = Find(tick);
+    if (!frame) {
+        return false;
+    }
+
+    const uint32_t* ids = Ids_.data() + frame->Offset;
+    const float* xs = X_.data() + frame->Offset;
+    const float* ys = Y_.data() + frame->Offset;
+    const float radius2 = radius * radius;
+    for (size_t i = 0; i < frame->Count; ++i) {
+        float dx = xs[i] - center.x();
+        float dy = ys[i] - center.y();
+        if (dx * dx + dy * dy <= radius2) {
+            out.push_back(ids[i]);
+        }
+    }
+
+    return true;
+}
+
+bool WorldHistory::QueryRay(uint64_t tick, const Eigen::Vector2f& origin, const Eigen::Vector2f& direction, float maxDistance, float objectRadius, std::vector<RayHit>& out) const {
+    const Frame* frame = Find(tick);
+    if (!frame) {
+        return false;
+    }
+
+    const uint32_t* ids = Ids_.data() + frame->Offset;
+    const float* xs = X_.data() + frame->Offset;
+    const float* ys = Y_.data() + frame->Offset;
+    const float radius2 = objectRadius * objectRadius;
+    for (size_t i = 0; i < frame->Count; ++i) {
+        float dx = xs[i] - origin.x();
+        float dy = ys[i] - origin.y();
+        float along = dx * direction.x() + dy * direction.y();
+        float across2 = dx * dx + dy * dy - along * along;
+        if (across2 > radius2) {
+            continue;
+        }
+
+        float distance = along - std::sqrt(radius2 - across2);
+        if (along + objectRadius < 0.0f || distance > maxDistance) {
+            continue;
+        }
+        out.push_back(RayHit { ids[i], std::max(distance, 0.0f) });
+    }
+
+    return true;
+}
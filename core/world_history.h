@@ -0,0 +1,67 @@
+#pragma once
+
+#include <core/world.h>
+
+#include <cstdint>
+#include <vector>
+
+// Fixed-size ring of past object positions for lag compensated queries, e.g. hit
+// detection against the world as a client saw it. Frames are stored as structure
+// of arrays in storage allocated once up front, so recording a tick never allocates.
+class WorldHistory {
+public:
+    WorldHistory(size_t frames, size_t maxObjects);
+
+    // Overwrites the oldest frame with the current positions. Objects beyond the
+    // capacity are not recorded and counted in GetDropped().
+    void Record(const World& world);
+
+    bool Contains(uint64_t tick) const {
+        return Find(tick) != nullptr;
+    }
+
+    uint64_t GetOldestTick() const;
+    uint64_t GetNewestTick() const;
+
+    // Appends ids of objects within radius of center at tick to out.
+    // Returns false if the tick is no longer (or not yet) in the history.
+    bool QueryRadius(uint64_t tick, const Eigen::Vector2f& center, float radius, std::vector<uint32_t>& out) const;
+
+    struct RayHit {
+        uint32_t Id;
+        float Distance;
+    };
+
+    // Appends objects, as discs of objectRadius, hit by the ray within maxDistance to out, unordered.
+    // direction must be normalized.
+    bool QueryRay(uint64_t tick, const Eigen::Vector2f& origin, const Eigen::Vector2f& direction, float maxDistance, float objectRadius, std::vector<RayHit>& out) const;
+
+    uint64_t GetDropped() const {
+        return Dropped_;
+    }
+
+    size_t GetMaxObjects() const {
+        return MaxObjects_;
+    }
+
+private:
+    struct Frame {
+        uint64_t Tick = 0;
+        size_t Count = 0;
+        // Offset of the frame's slice in the arrays below.
+        size_t Offset = 0;
+    };
+
+    const Frame* Find(uint64_t tick) const;
+
+private:
+    size_t MaxObjects_;
+    std::vector<Frame> Frames_;
+    size_t Head_ = 0;
+    size_t Count_ = 0;
+    uint64_t Dropped_ = 0;
+
+    std::vector<uint32_t> Ids_;
+    std::vector<float> X_;
+    std::vector<float> Y_;
+};
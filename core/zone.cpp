@@ -0,0 +1,150 @@
+#include <core/zone.h>
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+ZoneManager::ZoneManager(const ZoneConfig& config, uint32_t index)
+    : Config_(config)
+    , Index_(index)
+    , Random_(std::random_device()())
+{}
+
+uint32_t ZoneManager::Owner(float x) const {
+    float zone = std::floor(x / Config_.Width + Config_.Zones * 0.5f);
+    return std::clamp(zone, 0.0f, (float)(Config_.Zones - 1));
+}
+
+float ZoneManager::GetLow() const {
+    if (Index_ == 0) {
+        return -std::numeric_limits<float>::infinity();
+    }
+    return (Index_ - Config_.Zones * 0.5f) * Config_.Width;
+}
+
+float ZoneManager::GetHigh() const {
+    if (Index_ + 1 >= Config_.Zones) {
+        return std::numeric_limits<float>::infinity();
+    }
+    return (Index_ + 1 - Config_.Zones * 0.5f) * Config_.Width;
+}
+
+void ZoneManager::SetConnected(World& world, ZoneSide side, bool connected) {
+    Connected_[side] = connected && HasNeighbour(side);
+    if (connected) {
+        return;
+    }
+
+    for (uint32_t id : Mirrors_[side]) {
+        world.RemoveObject(id);
+    }
+    Mirrors_[side].clear();
+}
+
+void ZoneManager::Export(World& world, double time, std::array<proto::ZoneMessage, ZoneSides>& out, std::vector<ZonePlayerHandoff>& players) {
+    std::erase_if(Pending_, [&](const auto& item) {
+        if (time - item.second.Time < Config_.ClaimTimeout) {
+            return false;
+        }
+        Pinned_.erase(item.second.Id);
+        world.RemoveObject(item.second.Id);
+        return true;
+    });
+
+    const float low = GetLow();
+    const float high = GetHigh();
+
+    Leaving_.clear();
+    for (const auto& [id, object] : world.GetObjects()) {
+        if (IsMirror(id)) {
+            continue;
+        }
+
+        const float x = object.position.x();
+        if (!Pinned_.contains(id)) {
+            if (Connected_[ZoneLower] && x < low - Config_.Hysteresis) {
+                Leaving_.emplace_back(id, ZoneLower);
+                continue;
+            }
+            if (Connected_[ZoneUpper] && x >= high + Config_.Hysteresis) {
+                Leaving_.emplace_back(id, ZoneUpper);
+                continue;
+            }
+        }
+
+        if (Connected_[ZoneLower] && x < low + Config_.MirrorMargin) {
+            World::EncodeObject(object, out[ZoneLower].add_mirrors());
+        }
+        if (Connected_[ZoneUpper] && x >= high - Config_.MirrorMargin) {
+            World::EncodeObject(object, out[ZoneUpper].add_mirrors());
+        }
+    }
+
+    for (auto [id, side] : Leaving_) {
+        proto::ZoneObject* handoff = out[side].add_handoffs();
+        World::EncodeObject(*world.Find(id), handoff->mutable_object());
+
+        if (Players_.erase(id)) {
+            uint32_t token;
+            do {
+                token = Random_();
+            } while (token == 0);
+
+            handoff->set_player(true);
+            handoff->set_token(token);
+            players.push_back(ZonePlayerHandoff { id, GetNeighbour(side), token });
+        }
+
+        world.RemoveObject(id);
+    }
+}
+
+void ZoneManager::Import(World& world, ZoneSide from, const proto::ZoneMessage& message, double time) {
+    Object object;
+    for (const proto::ZoneObject& handoff : message.handoffs()) {
+        World::DecodeObject(handoff.object(), object);
+        Mirrors_[from].erase(object.id);
+        world.AdoptObject(object);
+        world.SetSimulated(object.id, true);
+
+        // Kept in place until the client arrives, so it is not handed on before it can claim it.
+        if (handoff.player() && handoff.token() != 0) {
+            Pinned_.insert(object.id);
+            Pending_[handoff.token()] = PendingClaim { object.id, time };
+        }
+    }
+
+    std::unordered_set<uint32_t> previous;
+    previous.swap(Mirrors_[from]);
+    for (const proto::Object& mirror : message.mirrors()) {
+        // An object handed back to this zone stays owned even if an older mirror list names it.
+        if (!previous.contains(mirror.id()) && world.Find(mirror.id())) {
+            continue;
+        }
+
+        // The neighbour simulates it and refreshes the copy every broadcast.
+        World::DecodeObject(mirror, object);
+        world.AdoptObject(object);
+        world.SetSimulated(object.id, false);
+        Mirrors_[from].insert(object.id);
+    }
+
+    for (uint32_t id : previous) {
+        if (!Mirrors_[from].contains(id)) {
+            world.RemoveObject(id);
+        }
+    }
+}
+
+bool ZoneManager::Claim(uint32_t token, uint32_t& id) {
+    auto it = Pending_.find(token);
+    if (it == Pending_.end()) {
+        return false;
+    }
+
+    id = it->second.Id;
+    Pinned_.erase(id);
+    Players_.insert(id);
+    Pending_.erase(it);
+    return true;
+}
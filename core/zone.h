@@ -0,0 +1,122 @@
+#pragma once
+
+#include <core/world.h>
+
+#include <object.pb.h>
+
+#include <array>
+#include <cstdint>
+#include <random>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+struct ZoneConfig {
+    uint32_t Zones = 1;
+    // Zones are strips along x of this width centred on the origin, the outer two extend to infinity.
+    float Width = 100.0f;
+    // Objects closer than this to a border are mirrored to the zone behind it.
+    float MirrorMargin = 10.0f;
+    // Objects are handed off this far past a border, so ones moving along it do not bounce.
+    float Hysteresis = 1.0f;
+    // Zone i serves clients on ClientPort + i and its neighbours on ZonePort + i.
+    uint16_t ClientPort = 8111;
+    uint16_t ZonePort = 8211;
+    // Handed off players whose client does not reconnect within this many seconds are removed.
+    double ClaimTimeout = 10.0;
+};
+
+enum ZoneSide : uint8_t {
+    ZoneLower = 0,
+    ZoneUpper = 1,
+    ZoneSides
+};
+
+// A client's object that moved to a neighbour, the client is redirected there.
+struct ZonePlayerHandoff {
+    uint32_t Id;
+    uint32_t Zone;
+    uint32_t Token;
+};
+
+// Ownership of one zone of a world partitioned between server processes.
+// Objects crossing a border are removed from the world and handed to the
+// neighbour, objects near a border are mirrored to it as read-only copies that
+// are replicated to its clients but never simulated or handed off there.
+// Not thread safe: the server calls it with global_lock held.
+class ZoneManager {
+public:
+    ZoneManager(const ZoneConfig& config, uint32_t index);
+
+    uint32_t GetIndex() const {
+        return Index_;
+    }
+
+    const ZoneConfig& GetConfig() const {
+        return Config_;
+    }
+
+    bool HasNeighbour(ZoneSide side) const {
+        return side == ZoneLower ? Index_ > 0 : Index_ + 1 < Config_.Zones;
+    }
+
+    uint32_t GetNeighbour(ZoneSide side) const {
+        return side == ZoneLower ? Index_ - 1 : Index_ + 1;
+    }
+
+    // Zone owning x.
+    uint32_t Owner(float x) const;
+
+    // Objects never handed off, like server owned NPCs that live in their spawning zone.
+    void Pin(uint32_t id) {
+        Pinned_.insert(id);
+    }
+
+    void AddPlayer(uint32_t id) {
+        Players_.insert(id);
+    }
+
+    void RemovePlayer(uint32_t id) {
+        Players_.erase(id);
+    }
+
+    bool IsMirror(uint32_t id) const {
+        return Mirrors_[ZoneLower].contains(id) || Mirrors_[ZoneUpper].contains(id);
+    }
+
+    // Handoffs are only made to connected neighbours, disconnecting drops their mirrors.
+    void SetConnected(World& world, ZoneSide side, bool connected);
+
+    // Removes owned objects that left the zone from the world into handoffs and
+    // lists objects near the borders as mirrors, one message per side. Handed off
+    // players are appended to players, their clients need a redirect. time is in seconds.
+    void Export(World& world, double time, std::array<proto::ZoneMessage, ZoneSides>& out, std::vector<ZonePlayerHandoff>& players);
+
+    // Adopts objects handed off by a neighbour and replaces its mirrors.
+    void Import(World& world, ZoneSide from, const proto::ZoneMessage& message, double time);
+
+    // Binds a client reconnecting with a handoff token to its object. Returns false for unknown tokens.
+    bool Claim(uint32_t token, uint32_t& id);
+
+private:
+    struct PendingClaim {
+        uint32_t Id;
+        double Time;
+    };
+
+    float GetLow() const;
+    float GetHigh() const;
+
+private:
+    ZoneConfig Config_;
+    uint32_t Index_;
+    std::unordered_set<uint32_t> Pinned_;
+    std::unordered_set<uint32_t> Players_;
+    std::array<std::unordered_set<uint32_t>, ZoneSides> Mirrors_;
+    std::array<bool, ZoneSides> Connected_ = {};
+    // Players handed to this zone whose client has not reconnected yet, by token.
+    std::unordered_map<uint32_t, PendingClaim> Pending_;
+    std::mt19937 Random_;
+    // Scratch, reused every export.
+    std::vector<std::pair<uint32_t, ZoneSide>> Leaving_;
+};
@@ -0,0 +1,252 @@
+#include <object.pb.h>
+#include <core/world.h>
+#include <core/replication.h>
+#include <core/replication_client.h>
+#include <core/channels.h>
+#include <core/packet_pool.h>
+#include <core/snapshot_encoder.h>
+#include <core/transport.h>
+#include <unordered_map>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <memory>
+#include <chrono>
+#include <iostream>
+
+PacketPool packet_pool;
+// The server's objects as of the last snapshots, extrapolated between them like a client does.
+World mirror;
+// Only used to keep the clock in sync with the server, spectators are answered in server time.
+ReplicationClient upstream_client;
+ReplicationConfig replication_config;
+// Spectators are encoded on the relay's single thread, large baselines are split into MTU sized packets.
+SnapshotEncoder snapshot_encoder(packet_pool, 1);
+std::vector<SnapshotJob> snapshot_jobs;
+uint64_t upstream_time = 0;
+
+struct SpectatorState {
+    PeerReplication replication;
+    // Point of interest, steered with the UserUpdates a player sends to move its object.
+    Eigen::Vector2f focus = Eigen::Vector2f::Zero();
+    Eigen::Vector2f velocity = Eigen::Vector2f::Zero();
+};
+
+uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+}
+
+void send(ITransport& transport, uint32_t peer, uint8_t channel, const google::protobuf::MessageLite& message, enet_uint32 flags) {
+    transport.Send(peer, channel, packet_pool.Create(message, flags));
+}
+
+// Snapshots may arrive out of order, objects already mirrored only take newer states.
+void apply_snapshot(const ENetPacket* packet) {
+    proto::ObjectsVector vector;
+    if (!vector.ParseFromArray(packet->data, packet->dataLength)) {
+        return;
+    }
+
+    for (uint32_t id : vector.objects_to_delete()) {
+        mirror.RemoveObject(id);
+    }
+
+    const bool stale = vector.server_time() < upstream_time;
+    const ClockSync& clock = upstream_client.GetClock();
+    // Brings the states to the current server time, the mirror is stepped from there.
+    float lag = 0.0f;
+    if (!stale && clock.IsSynchronized()) {
+        lag = std::max<int64_t>((int64_t)(clock.ToServerTime(ReplicationClient::LocalTime()) - vector.server_time()), 0) / 1000000000.0f;
+    }
+
+    for (const proto::Object& proto_object : vector.objects()) {
+        if (stale && mirror.Find(proto_object.id())) {
+            continue;
+        }
+        Object object;
+        World::DecodeObject(proto_object, object);
+        object.position += object.velocity * lag;
+        mirror.AdoptObject(object);
+    }
+
+    upstream_time = std::max(upstream_time, vector.server_time());
+}
+
+void handle_upstream(const TransportEvent& event, bool& connected) {
+    switch (event.Type) {
+        case TransportEventType::Connect:
+            printf("Connected to the server.\n");
+            connected = true;
+            break;
+
+        case TransportEventType::Disconnect:
+            printf("Disconnected from the server.\n");
+            connected = false;
+            // Spectators get the deletions with the next broadcast, the new connection sends everything again.
+            while (!mirror.GetObjects().empty()) {
+                mirror.RemoveObject(mirror.GetObjects().begin()->first);
+            }
+            upstream_time = 0;
+            break;
+
+        case TransportEventType::Receive:
+            if (event.Channel == ChannelSnapshots) {
+                apply_snapshot(event.Packet);
+            } else if (event.Channel == ChannelClock) {
+                upstream_client.HandlePacket(event.Channel, event.Packet, ReplicationClient::LocalTime());
+            }
+            enet_packet_destroy(event.Packet);
+            break;
+    }
+}
+
+void handle_downstream(ITransport& transport, const TransportEvent& event, std::unordered_map<uint32_t, SpectatorState>& spectators) {
+    switch (event.Type) {
+        case TransportEventType::Connect:
+            printf("A spectator connected as peer %u\n", event.Peer);
+            spectators.insert_or_assign(event.Peer, SpectatorState());
+            break;
+
+        case TransportEventType::Disconnect:
+            printf("Spectator %u disconnected.\n", event.Peer);
+            spectators.erase(event.Peer);
+            break;
+
+        case TransportEventType::Receive: {
+            auto it = spectators.find(event.Peer);
+            if (it == spectators.end()) {
+                enet_packet_destroy(event.Packet);
+                break;
+            }
+
+            if (event.Channel == ChannelClock) {
+                // Answered with the estimated server time, so spectators interpolate on the server's clock.
+                proto::ClockSync sync;
+                const ClockSync& clock = upstream_client.GetClock();
+                if (clock.IsSynchronized() && sync.ParseFromArray(event.Packet->data, event.Packet->dataLength)) {
+                    sync.set_server_time(clock.ToServerTime(ReplicationClient::LocalTime()));
+                    send(transport, event.Peer, ChannelClock, sync, ENET_PACKET_FLAG_UNSEQUENCED);
+                }
+            } else if (event.Channel == ChannelSnapshots) {
+                proto::UserUpdate uu;
+                if (uu.ParseFromArray(event.Packet->data, event.Packet->dataLength)) {
+                    it->second.velocity = Eigen::Vector2f(std::clamp(uu.velocity().x(), -1.0f, 1.0f), std::clamp(uu.velocity().y(), -1.0f, 1.0f)) * 10.0f;
+                }
+            }
+            enet_packet_destroy(event.Packet);
+            break;
+        }
+    }
+}
+
+void broadcast(ITransport& transport, std::unordered_map<uint32_t, SpectatorState>& spectators, float delta) {
+    mirror.Step(delta);
+
+    snapshot_jobs.clear();
+    for (auto& [peer, state] : spectators) {
+        state.focus += state.velocity * delta;
+        state.replication.SetFocus(state.focus);
+        snapshot_jobs.push_back(SnapshotJob { peer, &state.replication });
+    }
+
+    snapshot_encoder.Encode(mirror, replication_config, upstream_client.GetClock().ToServerTime(ReplicationClient::LocalTime()), snapshot_jobs);
+    for (const SnapshotJob& job : snapshot_jobs) {
+        for (ENetPacket* packet : job.Packets) {
+            transport.Send(job.Peer, ChannelSnapshots, packet);
+        }
+    }
+
+    mirror.ClearPending();
+}
+
+int main(int argc, char** argv) {
+    // relay --relay-key k [server host] [server port] [port] [interest radius]
+    // Connects to the server as a relay peer with the key the server was started with and
+    // serves spectators on port, each of them gets the objects within the interest radius
+    // of its point of interest, zero for all.
+    uint32_t relay_key = NoRelayKey;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--relay-key" && i + 1 < argc) {
+            relay_key = (uint32_t)std::stoul(argv[++i], nullptr, 0);
+        } else {
+            args.push_back(arg);
+        }
+    }
+    if (relay_key == NoRelayKey) {
+        std::cout << "The relay needs the server's non-zero --relay-key." << std::endl;
+        return 1;
+    }
+
+    std::string host = args.size() > 0 ? args[0] : "127.0.0.1";
+    uint16_t upstream_port = args.size() > 1 ? std::stoul(args[1]) : 8111;
+    uint16_t port = args.size() > 2 ? std::stoul(args[2]) : 8311;
+    replication_config.InterestRadius = args.size() > 3 ? std::stof(args[3]) : 50.0f;
+    replication_config.MaxCreationsPerSnapshot = 256;
+
+    std::unique_ptr<EnetTransport> downstream = EnetTransport::Listen(port, 256);
+    if (!downstream) {
+        std::cout << "An error occurred while trying to create an ENet relay host." << std::endl;
+        abort();
+    }
+    std::cout << "Relay for " << host << ":" << upstream_port << " started on port " << port << "." << std::endl;
+
+    std::unique_ptr<EnetTransport> upstream;
+    bool connected = false;
+    uint64_t retry = 0;
+
+    std::unordered_map<uint32_t, SpectatorState> spectators;
+    std::vector<TransportEvent> events;
+    uint64_t last_broadcast = now();
+    uint64_t last_report = last_broadcast;
+
+    while (downstream->Service(events, 5)) {
+        for (const TransportEvent& event : events) {
+            handle_downstream(*downstream, event, spectators);
+        }
+        events.clear();
+
+        // A failed or lost connection is retried with a new host.
+        if (!upstream && now() >= retry) {
+            upstream = EnetTransport::Connect(host.c_str(), upstream_port, relay_key);
+            retry = now() + 1000000000;
+        }
+        if (upstream) {
+            upstream->Service(events, 0);
+            // Packets received after a disconnect belong to the lost connection, they are only destroyed.
+            bool lost = false;
+            for (const TransportEvent& event : events) {
+                if (!lost) {
+                    handle_upstream(event, connected);
+                    lost = event.Type == TransportEventType::Disconnect;
+                } else if (event.Type == TransportEventType::Receive) {
+                    enet_packet_destroy(event.Packet);
+                }
+            }
+            events.clear();
+            if (lost) {
+                upstream.reset();
+            }
+        }
+
+        uint64_t time = now();
+        if (time - last_broadcast < 10000000) {
+            continue;
+        }
+        float delta = (time - last_broadcast) / 1000000000.0f;
+        last_broadcast = time;
+
+        if (connected) {
+            upstream_client.Update(*upstream, 0, ReplicationClient::LocalTime());
+        }
+        broadcast(*downstream, spectators, delta);
+
+        if (time - last_report >= 1000000000) {
+            last_report = time;
+            printf("relay: %zu objects, %zu spectators, packet pool %llu hits %llu misses\n", mirror.Size(), spectators.size(), (unsigned long long)packet_pool.GetHits(), (unsigned long long)packet_pool.GetMisses());
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,643 @@
+#include <object.pb.h>
+#include <core/world.h>
+#include <core/replication.h>
+#include <core/terrain_collision.h>
+#include <core/world_history.h>
+#include <core/npc.h>
+#include <core/packet_pool.h>
+#include <core/loopback_transport.h>
+#include <core/replication_client.h>
+#include <core/channels.h>
+#include <core/lockstep.h>
+#include <core/alloc_tracker.h>
+#include <core/snapshot_encoder.h>
+#include <core/snapshot_buffer.h>
+#include <enet/enet.h>
+
+#include <array>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+// Offline tick benchmark: drives a synthetic world without sockets and reports
+// the cost of every stage of a server tick normalized per object.
+//
+// Usage: server_bench [objects] [peers] [ticks]
+// Without arguments a fixed matrix of world sizes is measured, followed by correctness
+// checks of late joins, relay streams and lockstep replays. Exits with an error if one fails.
+//
+// Built with -DALLOCATION_TRACKING=ON it also reports steady state heap allocations
+// per tick phase and exits with an error if a phase that must not allocate does.
+
+namespace {
+
+uint64_t now() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
+}
+
+// Tick phases whose allocations are tracked, measured after the warm-up half of the ticks.
+enum Phase {
+    PhaseStep,
+    PhaseCollide,
+    PhaseRecord,
+    PhaseRewind,
+    PhaseEncode,
+    PhaseReplicate,
+    PhaseCount
+};
+
+const char* phase_names[PhaseCount] = { "step", "collide", "record", "rewind", "encode", "replicate" };
+const bool phase_allocation_free[PhaseCount] = { true, true, true, true, false, false };
+
+bool allocation_regression = false;
+// Set when a correctness check reports FAILED.
+bool check_failed = false;
+
+void check_allocations(const char* phase, const AllocationStats& stats) {
+    if (AllocationStats::IsTracking() && stats.Allocations > 0) {
+        printf("  ALLOCATION REGRESSION: %s allocated %llu times, %llu bytes\n", phase, (unsigned long long)stats.Allocations, (unsigned long long)stats.Bytes);
+        allocation_regression = true;
+    }
+}
+
+struct BenchResult {
+    double StepNs = 0;
+    double CollideNs = 0;
+    double EncodeNs = 0;
+    double FanoutNs = 0;
+    double ReplicateNs = 0;
+    double RecordNs = 0;
+    double QueryUs = 0;
+    double SentFraction = 0;
+    double PoolHitRate = 0;
+    size_t PacketSize = 0;
+    // Steady state allocations per tick.
+    std::array<AllocationStats, PhaseCount> Allocations;
+    std::array<size_t, PhaseCount> AllocationTicks = {};
+};
+
+void populate(World& world, size_t objects) {
+    for (size_t i = 0; i < objects; ++i) {
+        Object& object = world.CreateObject();
+        object.position = Eigen::Vector2f::Random() * 100.0f;
+        object.velocity = Eigen::Vector2f::Random() * 10.0f;
+        object.rotation = (float)rand() / RAND_MAX;
+    }
+    world.ClearPending();
+}
+
+BenchResult run(size_t objects, size_t peers, size_t ticks) {
+    World world;
+    populate(world, objects);
+
+    BenchResult result;
+    uint64_t stepTime = 0;
+    uint64_t collideTime = 0;
+    uint64_t encodeTime = 0;
+    uint64_t fanoutTime = 0;
+    uint64_t replicateTime = 0;
+    uint64_t recordTime = 0;
+    uint64_t queryTime = 0;
+    size_t sent = 0;
+    std::string data;
+
+    TerrainVolume terrain;
+    TerrainChunkCache terrainCache(terrain);
+    TerrainCollider collider(terrainCache);
+
+    WorldHistory history(64, objects);
+    std::vector<uint32_t> hits;
+    hits.reserve(objects);
+
+    PacketPool pool;
+    ReplicationConfig config;
+    std::vector<PeerReplication> replications(peers);
+    std::vector<uint32_t> ids;
+    for (const auto& [id, object] : world.GetObjects()) {
+        ids.push_back(id);
+    }
+
+    for (size_t tick = 0; tick < ticks; ++tick) {
+        // Mostly cruising objects: one in a hundred steers every tick.
+        for (size_t i = 0; i < ids.size() / 100; ++i) {
+            world.Find(ids[rand() % ids.size()])->velocity = Eigen::Vector2f::Random() * 10.0f;
+        }
+
+        // The server prefetches on the network thread, it is not part of the tick.
+        collider.Prefetch(world);
+
+        std::array<AllocationStats, PhaseCount + 1> allocations;
+
+        allocations[PhaseStep] = AllocationStats::Current();
+        uint64_t t0 = now();
+        world.Step(0.01f);
+
+        allocations[PhaseCollide] = AllocationStats::Current();
+        uint64_t tc = now();
+        collider.Collide(world);
+
+        allocations[PhaseRecord] = AllocationStats::Current();
+        uint64_t tr = now();
+        history.Record(world);
+
+        // Rewind query half the history back, like a hit check from a lagging client.
+        allocations[PhaseRewind] = AllocationStats::Current();
+        uint64_t tq = now();
+        hits.clear();
+        history.QueryRadius(world.GetTick() - std::min<uint64_t>(world.GetTick() - 1, 32), Eigen::Vector2f::Zero(), 10.0f, hits);
+
+        allocations[PhaseEncode] = AllocationStats::Current();
+        uint64_t t1 = now();
+        proto::ObjectsVector vector;
+        bool reliable = world.EncodeSnapshot(vector);
+        vector.SerializeToString(&data);
+
+        // Every virtual peer gets its own packet, this is what enet_host_broadcast
+        // and per-peer snapshots cost on the network thread.
+        uint64_t t2 = now();
+        for (size_t peer = 0; peer < peers; ++peer) {
+            ENetPacket* packet = enet_packet_create(data.data(), data.size(), reliable ? ENET_PACKET_FLAG_RELIABLE : ENET_PACKET_FLAG_UNSEQUENCED);
+            enet_packet_destroy(packet);
+        }
+
+        // Per-peer dead reckoning encode into pooled packets, skipping the warm-up tick that sends everything.
+        allocations[PhaseReplicate] = AllocationStats::Current();
+        uint64_t t3 = now();
+        for (PeerReplication& replication : replications) {
+            proto::ObjectsVector peerVector;
+            replication.Encode(world, config, peerVector);
+            enet_packet_destroy(pool.Create(peerVector, ENET_PACKET_FLAG_UNSEQUENCED));
+            if (tick > 0) {
+                sent += peerVector.objects_size();
+            }
+        }
+        world.ClearPending();
+
+        allocations[PhaseCount] = AllocationStats::Current();
+        uint64_t t4 = now();
+        stepTime += tc - t0;
+        collideTime += tr - tc;
+        recordTime += tq - tr;
+        queryTime += t1 - tq;
+        encodeTime += t2 - t1;
+        fanoutTime += t3 - t2;
+        replicateTime += t4 - t3;
+
+        if (tick >= ticks / 2) {
+            for (size_t phase = 0; phase < PhaseCount; ++phase) {
+                // The encode phase ends where fanout starts, fanout only allocates through ENet's malloc.
+                const AllocationStats& end = phase == PhaseEncode ? allocations[PhaseReplicate] : allocations[phase + 1];
+                result.Allocations[phase] += end - allocations[phase];
+                ++result.AllocationTicks[phase];
+            }
+        }
+    }
+
+    double samples = (double)ticks * objects;
+    result.StepNs = stepTime / samples;
+    result.CollideNs = collideTime / samples;
+    result.RecordNs = recordTime / samples;
+    result.QueryUs = queryTime / 1000.0 / ticks;
+    result.EncodeNs = encodeTime / samples;
+    result.FanoutNs = peers ? fanoutTime / (samples * peers) : 0.0;
+    result.ReplicateNs = peers ? replicateTime / (samples * peers) : 0.0;
+    result.SentFraction = peers && ticks > 1 ? (double)sent / ((ticks - 1) * objects * peers) : 0.0;
+    result.PacketSize = data.size();
+    result.PoolHitRate = pool.GetHits() + pool.GetMisses() ? (double)pool.GetHits() / (pool.GetHits() + pool.GetMisses()) : 0.0;
+    return result;
+}
+
+double run_npcs(size_t agents, size_t ticks) {
+    World world;
+    NpcSystem npcs;
+    for (size_t i = 0; i < agents; ++i) {
+        npcs.Spawn(world, Eigen::Vector2f::Random() * 100.0f, i % 2 ? NpcBehavior::Flock : NpcBehavior::Wander);
+    }
+
+    uint64_t time = 0;
+    for (size_t tick = 0; tick < ticks; ++tick) {
+        AllocationScope allocations;
+        uint64_t t0 = now();
+        npcs.Update(world, 0.01f);
+        time += now() - t0;
+        // The first update sizes the scratch arrays.
+        if (tick > 0) {
+            check_allocations("npc update", allocations.Get());
+        }
+        world.Step(0.01f);
+    }
+
+    return (double)time / ticks / agents;
+}
+
+// Full replication pipeline over the loopback transport: per-peer encode into pooled
+// packets, delivery and client side decoding into the snapshot buffers.
+double run_loopback(size_t objects, size_t peers, size_t ticks) {
+    World world;
+    populate(world, objects);
+
+    PacketPool pool;
+    ReplicationConfig config;
+    LoopbackNetwork network;
+    LoopbackTransport server(network);
+    std::vector<std::unique_ptr<LoopbackTransport>> transports;
+    std::vector<ReplicationClient> clients(peers);
+    std::vector<PeerReplication> replications(peers);
+    std::vector<uint32_t> handles;
+    for (size_t i = 0; i < peers; ++i) {
+        transports.push_back(std::make_unique<LoopbackTransport>(network));
+        transports.back()->Connect(server);
+    }
+
+    std::vector<TransportEvent> events;
+    server.Service(events, 0);
+    for (const TransportEvent& event : events) {
+        handles.push_back(event.Peer);
+    }
+
+    uint64_t time = 0;
+    for (size_t tick = 0; tick < ticks; ++tick) {
+        world.Step(0.01f);
+
+        uint64_t t0 = now();
+        for (size_t i = 0; i < peers; ++i) {
+            proto::ObjectsVector vector;
+            bool reliable = replications[i].Encode(world, config, vector);
+            vector.set_server_time((uint64_t)(world.GetTime() * 1e9));
+            vector.set_tick(world.GetTick());
+            server.Send(handles[i], ChannelSnapshots, pool.Create(vector, reliable ? ENET_PACKET_FLAG_RELIABLE : ENET_PACKET_FLAG_UNSEQUENCED));
+        }
+        world.ClearPending();
+
+        for (size_t i = 0; i < peers; ++i) {
+            events.clear();
+            transports[i]->Service(events, 0);
+            for (const TransportEvent& event : events) {
+                if (event.Type == TransportEventType::Receive) {
+                    clients[i].HandlePacket(event.Channel, event.Packet, t0);
+                    enet_packet_destroy(event.Packet);
+                }
+            }
+        }
+        time += now() - t0;
+    }
+
+    return (double)time / ((double)ticks * objects * peers);
+}
+
+struct RateLodResult {
+    double SentFraction = 0;
+    double EncodeNs = 0;
+};
+
+// Dead reckoning replication to peers spread over the world, with every object
+// checked every snapshot or with the given update rate distance tiers.
+RateLodResult run_rate_lod(size_t objects, size_t peers, size_t ticks, const std::vector<float>& distances) {
+    srand(1);
+    World world;
+    populate(world, objects);
+
+    ReplicationConfig config;
+    config.UpdateRateDistances = distances;
+    std::vector<PeerReplication> replications(peers);
+    for (PeerReplication& replication : replications) {
+        replication.SetFocus(Eigen::Vector2f::Random() * 100.0f);
+    }
+
+    std::vector<uint32_t> ids;
+    for (const auto& [id, object] : world.GetObjects()) {
+        ids.push_back(id);
+    }
+
+    size_t sent = 0;
+    uint64_t time = 0;
+    for (size_t tick = 0; tick < ticks; ++tick) {
+        // Busier than the tick benchmark, one in ten steers every tick like wandering NPCs.
+        for (size_t i = 0; i < ids.size() / 10; ++i) {
+            world.Find(ids[rand() % ids.size()])->velocity = Eigen::Vector2f::Random() * 10.0f;
+        }
+        world.Step(0.01f);
+
+        uint64_t t0 = now();
+        for (PeerReplication& replication : replications) {
+            proto::ObjectsVector vector;
+            replication.Encode(world, config, vector);
+            if (tick > 0) {
+                sent += vector.objects_size();
+            }
+        }
+        time += now() - t0;
+        world.ClearPending();
+    }
+
+    RateLodResult result;
+    result.SentFraction = ticks > 1 ? (double)sent / ((ticks - 1) * objects * peers) : 0.0;
+    result.EncodeNs = (double)time / ((double)ticks * objects * peers);
+    return result;
+}
+
+// A relay peer has no focus under the server's replication config, its snapshots must
+// carry the same objects as those of a peer replicated without interest radius and tiers.
+bool run_relay_stream(size_t objects, size_t ticks) {
+    srand(1);
+    World world;
+    populate(world, objects);
+
+    ReplicationConfig config;
+    config.InterestRadius = 50.0f;
+    config.UpdateRateDistances = { 25.0f, 50.0f, 100.0f };
+    config.MaxCreationsPerSnapshot = 256;
+    ReplicationConfig fullConfig;
+    fullConfig.MaxCreationsPerSnapshot = config.MaxCreationsPerSnapshot;
+    PeerReplication relay;
+    PeerReplication full;
+
+    std::vector<uint32_t> ids;
+    for (const auto& [id, object] : world.GetObjects()) {
+        ids.push_back(id);
+    }
+
+    size_t sent = 0;
+    for (size_t tick = 0; tick < ticks; ++tick) {
+        for (size_t i = 0; i < ids.size() / 10; ++i) {
+            world.Find(ids[rand() % ids.size()])->velocity = Eigen::Vector2f::Random() * 10.0f;
+        }
+        world.Step(0.01f);
+
+        proto::ObjectsVector relayVector;
+        proto::ObjectsVector fullVector;
+        relay.Encode(world, config, relayVector);
+        full.Encode(world, fullConfig, fullVector);
+        if (relayVector.objects_size() != fullVector.objects_size()) {
+            return false;
+        }
+        for (int i = 0; i < relayVector.objects_size(); ++i) {
+            if (relayVector.objects(i).id() != fullVector.objects(i).id()) {
+                return false;
+            }
+        }
+        sent += relayVector.objects_size();
+        world.ClearPending();
+    }
+    return relay.GetKnownObjects() == objects && sent > objects;
+}
+
+// Per-peer snapshot encoding into pooled packets on the calling thread versus the
+// encoder's workers, in ns per object and peer.
+std::pair<double, double> run_parallel(size_t objects, size_t peers, size_t ticks) {
+    World world;
+    populate(world, objects);
+
+    PacketPool pool;
+    ReplicationConfig config;
+    SnapshotEncoder serial(pool, 1);
+    SnapshotEncoder parallel(pool);
+    std::vector<PeerReplication> replications(2 * peers);
+    std::vector<SnapshotJob> serialJobs;
+    std::vector<SnapshotJob> parallelJobs;
+    for (size_t i = 0; i < peers; ++i) {
+        serialJobs.push_back(SnapshotJob { (uint32_t)i, &replications[i] });
+        parallelJobs.push_back(SnapshotJob { (uint32_t)i, &replications[peers + i] });
+    }
+
+    uint64_t serialTime = 0;
+    uint64_t parallelTime = 0;
+    for (size_t tick = 0; tick < ticks; ++tick) {
+        world.Step(0.01f);
+
+        for (auto [encoder, jobs, time] : { std::tuple(&serial, &serialJobs, &serialTime), std::tuple(&parallel, &parallelJobs, &parallelTime) }) {
+            uint64_t t0 = now();
+            encoder->Encode(world, config, tick, *jobs);
+            for (const SnapshotJob& job : *jobs) {
+                for (ENetPacket* packet : job.Packets) {
+                    enet_packet_destroy(packet);
+                }
+            }
+            *time += now() - t0;
+        }
+        world.ClearPending();
+    }
+
+    double samples = (double)ticks * objects * peers;
+    return { serialTime / samples, parallelTime / samples };
+}
+
+struct LateJoinResult {
+    size_t Ticks = 0;
+    size_t Packets = 0;
+    size_t MaxPacketBytes = 0;
+    size_t MaxTickBytes = 0;
+    double MaxTickUs = 0;
+    bool Complete = false;
+};
+
+// A peer joining a populated world, until its client knows every object. Baselines
+// are budgeted per snapshot and split into packets, or sent whole with a zero budget.
+LateJoinResult run_late_join(size_t objects, size_t budget) {
+    World world;
+    populate(world, objects);
+
+    PacketPool pool;
+    ReplicationConfig config;
+    config.MaxCreationsPerSnapshot = budget;
+    SnapshotEncoder encoder(pool, 1);
+    PeerReplication replication;
+    std::vector<SnapshotJob> jobs = { SnapshotJob { 0, &replication } };
+    SnapshotBuffer client;
+
+    LateJoinResult result;
+    while (client.Size() < objects && result.Ticks < 10000) {
+        world.Step(0.01f);
+
+        uint64_t t0 = now();
+        encoder.Encode(world, config, result.Ticks, jobs);
+        result.MaxTickUs = std::max(result.MaxTickUs, (now() - t0) / 1000.0);
+
+        size_t bytes = 0;
+        for (ENetPacket* packet : jobs[0].Packets) {
+            proto::ObjectsVector vector;
+            vector.ParseFromArray(packet->data, packet->dataLength);
+            client.Apply(vector, vector.server_time());
+            result.MaxPacketBytes = std::max(result.MaxPacketBytes, packet->dataLength);
+            bytes += packet->dataLength;
+            ++result.Packets;
+            enet_packet_destroy(packet);
+        }
+        result.MaxTickBytes = std::max(result.MaxTickBytes, bytes);
+        ++result.Ticks;
+    }
+
+    result.Complete = client.Size() == objects;
+    return result;
+}
+
+struct LockstepResult {
+    double StepNs = 0;
+    double FrameBytes = 0;
+    bool Replayed = false;
+};
+
+// Lockstep simulation driven by synthetic input frames, then replayed from the
+// initial state on a second simulation that must end with the same hash.
+LockstepResult run_lockstep(size_t objects, size_t ticks) {
+    std::vector<proto::LockstepFrame> frames(ticks);
+    for (size_t tick = 0; tick < ticks; ++tick) {
+        proto::LockstepFrame& frame = frames[tick];
+        frame.set_tick(tick + 1);
+        if (tick == 0) {
+            for (size_t i = 0; i < objects; ++i) {
+                frame.add_joins(i + 1);
+            }
+        }
+        // Same input rate as the snapshot benchmark: one in a hundred steers every tick.
+        for (size_t i = 0; i < objects / 100; ++i) {
+            proto::UserUpdate update;
+            update.mutable_velocity()->set_x((float)rand() / RAND_MAX * 2.0f - 1.0f);
+            update.mutable_velocity()->set_y((float)rand() / RAND_MAX * 2.0f - 1.0f);
+            LockstepSimulation::EncodeInput(rand() % objects + 1, update, frame.add_inputs());
+        }
+    }
+
+    LockstepResult result;
+    LockstepSimulation simulation;
+    uint64_t time = 0;
+    size_t bytes = 0;
+    for (size_t tick = 0; tick < ticks; ++tick) {
+        AllocationScope allocations;
+        uint64_t t0 = now();
+        simulation.Step(frames[tick]);
+        frames[tick].set_hash(simulation.Hash());
+        time += now() - t0;
+        // Only the first frame's joins grow the body array.
+        if (tick > 0) {
+            check_allocations("lockstep step", allocations.Get());
+        }
+        if (tick > 0) {
+            bytes += frames[tick].ByteSizeLong();
+        }
+    }
+
+    // A client's copy: fresh state, frames off the wire, every tick must hash like the server's.
+    LockstepSimulation replay;
+    result.Replayed = true;
+    std::string data;
+    for (const proto::LockstepFrame& frame : frames) {
+        proto::LockstepFrame received;
+        frame.SerializeToString(&data);
+        if (!received.ParseFromString(data) || !replay.Step(received) || replay.Hash() != frame.hash()) {
+            result.Replayed = false;
+            break;
+        }
+    }
+
+    result.StepNs = (double)time / ((double)ticks * objects);
+    result.FrameBytes = ticks > 1 ? (double)bytes / (ticks - 1) : 0.0;
+    return result;
+}
+
+void report(size_t objects, size_t peers, size_t ticks) {
+    BenchResult result = run(objects, peers, ticks);
+    printf("%8zu %6zu %6zu %12.2f %12.2f %12.2f %12.2f %12.2f %16.2f %16.2f %8.3f %8.3f %12zu\n", objects, peers, ticks, result.StepNs, result.CollideNs, result.RecordNs, result.QueryUs, result.EncodeNs, result.FanoutNs, result.ReplicateNs, result.SentFraction, result.PoolHitRate, result.PacketSize);
+
+    if (!AllocationStats::IsTracking()) {
+        return;
+    }
+    printf("  allocations/tick:");
+    for (size_t phase = 0; phase < PhaseCount; ++phase) {
+        const AllocationStats& stats = result.Allocations[phase];
+        size_t ticks = std::max<size_t>(result.AllocationTicks[phase], 1);
+        printf(" %s %.1f (%.0f B)", phase_names[phase], (double)stats.Allocations / ticks, (double)stats.Bytes / ticks);
+    }
+    printf("\n");
+    for (size_t phase = 0; phase < PhaseCount; ++phase) {
+        if (phase_allocation_free[phase]) {
+            check_allocations(phase_names[phase], result.Allocations[phase]);
+        }
+    }
+}
+
+}
+
+int main(int argc, char** argv) {
+    srand(1);
+
+    printf("%8s %6s %6s %12s %12s %12s %12s %12s %16s %16s %8s %8s %12s\n", "objects", "peers", "ticks", "step ns/obj", "collide ns/obj", "record ns/obj", "rewind us", "encode ns/obj", "fanout ns/obj/peer", "replicate ns/obj/peer", "sent", "pool hit", "packet bytes");
+
+    if (argc > 1) {
+        size_t objects = std::stoul(argv[1]);
+        size_t peers = argc > 2 ? std::stoul(argv[2]) : 32;
+        size_t ticks = argc > 3 ? std::stoul(argv[3]) : 100;
+        report(objects, peers, ticks);
+        return 0;
+    }
+
+    for (size_t objects : { 100, 1000, 10000, 100000 }) {
+        for (size_t peers : { 1, 32 }) {
+            report(objects, peers, objects >= 100000 ? 10 : 100);
+        }
+    }
+
+    printf("\n%8s %6s %20s\n", "objects", "peers", "loopback ns/obj/peer");
+    for (size_t objects : { 1000, 10000 }) {
+        for (size_t peers : { 1, 32 }) {
+            printf("%8zu %6zu %20.2f\n", objects, peers, run_loopback(objects, peers, 100));
+        }
+    }
+
+    printf("\n%8s %6s %8s %20s %20s\n", "objects", "peers", "threads", "serial ns/obj/peer", "parallel ns/obj/peer");
+    for (size_t objects : { 1000, 10000 }) {
+        for (size_t peers : { 8, 64 }) {
+            auto [serial, parallel] = run_parallel(objects, peers, 100);
+            printf("%8zu %6zu %8u %20.2f %20.2f\n", objects, peers, std::thread::hardware_concurrency(), serial, parallel);
+        }
+    }
+
+    printf("\n%8s %8s %6s %8s %12s %12s %12s %8s\n", "objects", "budget", "ticks", "packets", "max packet", "max tick B", "max tick us", "baseline");
+    for (size_t objects : { 1000, 10000, 100000 }) {
+        for (size_t budget : { 0, 256 }) {
+            LateJoinResult result = run_late_join(objects, budget);
+            check_failed |= !result.Complete;
+            printf("%8zu %8zu %6zu %8zu %12zu %12zu %12.1f %8s\n", objects, budget, result.Ticks, result.Packets, result.MaxPacketBytes, result.MaxTickBytes, result.MaxTickUs, result.Complete ? "ok" : "FAILED");
+        }
+    }
+
+    printf("\n%8s %6s %12s %12s %16s %16s\n", "objects", "peers", "sent", "lod sent", "encode ns/obj", "lod encode ns/obj");
+    for (size_t objects : { 1000, 10000 }) {
+        RateLodResult full = run_rate_lod(objects, 8, 100, {});
+        RateLodResult lod = run_rate_lod(objects, 8, 100, { 25.0f, 50.0f, 100.0f });
+        printf("%8zu %6d %12.3f %12.3f %16.2f %16.2f\n", objects, 8, full.SentFraction, lod.SentFraction, full.EncodeNs, lod.EncodeNs);
+    }
+
+    printf("\n%8s %12s\n", "objects", "relay stream");
+    for (size_t objects : { 1000, 10000 }) {
+        bool ok = run_relay_stream(objects, 100);
+        check_failed |= !ok;
+        printf("%8zu %12s\n", objects, ok ? "ok" : "FAILED");
+    }
+
+    printf("\n%8s %16s %16s %8s\n", "objects", "lockstep ns/obj", "frame bytes", "replay");
+    for (size_t objects : { 1000, 10000, 100000 }) {
+        LockstepResult result = run_lockstep(objects, 100);
+        check_failed |= !result.Replayed;
+        printf("%8zu %16.2f %16.1f %8s\n", objects, result.StepNs, result.FrameBytes, result.Replayed ? "ok" : "FAILED");
+    }
+
+    printf("\n%8s %16s\n", "agents", "npc ns/agent");
+    for (size_t agents : { 1000, 10000, 50000 }) {
+        printf("%8zu %16.2f\n", agents, run_npcs(agents, 100));
+    }
+
+    if (allocation_regression) {
+        printf("\nSteady state allocations found in allocation free phases.\n");
+    }
+    if (check_failed) {
+        printf("\nA correctness check failed.\n");
+    }
+
+    return allocation_regression || check_failed ? 1 : 0;
+}
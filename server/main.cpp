@@ -1,20 +1,120 @@
 #include <iostream>
 #include <object.pb.h>
-#include <core/object.h>
+#include <core/world.h>
+#include <core/replication.h>
+#include <core/channels.h>
+#include <core/terrain.h>
+#include <core/terrain_edit.h>
+#include <core/terrain_collision.h>
+#include <core/world_history.h>
+#include <core/npc.h>
+#include <core/packet_pool.h>
+#include <core/transport.h>
+#include <core/loopback_transport.h>
+#include <core/replication_client.h>
+#include <core/zone.h>
+#include <core/lockstep.h>
+#include <core/snapshot_encoder.h>
+#include <core/token_bucket.h>
 #include <unordered_map>
-#include <unordered_set>
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <array>
+#include <optional>
 #include <chrono>
 #include <thread>
 #include <mutex>
-#include <enet/enet.h>
+#include <random>
 #include <iostream>
 
 std::mutex global_lock;
-std::unordered_map<uint32_t, Object> world_objects;
-std::vector<uint32_t> objects_to_delete;
-std::unordered_set<uint32_t> objects_to_create;
+PacketPool packet_pool;
+// Guards the chunk cache entries the collider samples. The network thread owns the edit log
+// and the cache, it builds chunks without the lock and takes it only to change entries.
+// Taken after global_lock, never before it.
+std::mutex terrain_lock;
+World world;
+NpcSystem npcs;
+ReplicationConfig replication_config;
+// About 0.64 s of lag compensation at 100 Hz. Sized in main for every NPC and client,
+// objects that do not fit are missing from rewound queries.
+std::unique_ptr<WorldHistory> world_history;
+uint64_t world_history_dropped = 0;
+TerrainVolume terrain;
+TerrainEditLog terrain_edits;
+TerrainChunkCache terrain_cache(terrain, &terrain_edits, 4096, &terrain_lock);
+TerrainCollider terrain_collider(terrain_cache);
+uint32_t sent_edit_sequence = 0;
+TerrainStreamConfig terrain_stream_config;
+// Set when the world is split between zone server processes.
+std::unique_ptr<ZoneManager> zone_manager;
+// Set in lockstep mode: objects are simulated deterministically and only input frames are replicated.
+std::unique_ptr<LockstepSimulation> lockstep;
+// Input collected for the next lockstep tick and ticked frames waiting for the broadcast. Guarded by global_lock.
+proto::LockstepFrame lockstep_input;
+std::vector<proto::LockstepFrame> lockstep_frames;
+uint32_t lockstep_next_id = 1;
+// Copy of the world taken under global_lock at every broadcast. Snapshots are encoded
+// from it on the encoder's workers while the simulation carries on. Network thread only.
+World published_world;
+SnapshotEncoder snapshot_encoder(packet_pool);
+std::vector<SnapshotJob> snapshot_jobs;
 volatile bool stop = false;
-volatile uint32_t next_id = 1;
+
+// Peer limit of the client host, relays included.
+constexpr size_t max_clients = 32;
+
+// Every packet a client sends takes a token, clients send a UserUpdate per frame at most.
+constexpr double input_rate = 250.0;
+constexpr double input_burst = 64.0;
+// Every terrain edit takes a token as well, each one is replicated to every peer.
+constexpr double edit_rate = 8.0;
+constexpr double edit_burst = 16.0;
+// Edits the log keeps before older ones are folded into chunk baselines.
+constexpr size_t max_logged_edits = 256;
+
+// Relays are only accepted with the key given by --relay-key, none without it.
+uint32_t relay_key = NoRelayKey;
+
+struct PeerLimits {
+    TokenBucket input { input_rate, input_burst };
+    TokenBucket edits { edit_rate, edit_burst };
+    // Set on connect, relays only receive.
+    bool relay = false;
+};
+
+bool is_relay(const TransportEvent& event) {
+    return relay_key != NoRelayKey && event.Data == relay_key;
+}
+
+// Largest packet accepted per channel, checked before parsing. UserUpdates are around 20 bytes.
+constexpr std::array<size_t, ChannelCount> max_input_size = {
+    64,   // ChannelSnapshots: UserUpdate
+    32,   // ChannelClock: ClockSync
+    4096, // ChannelTerrain: batched terrain edits
+    0,    // ChannelZone: server to client only
+    0,    // ChannelLockstep: server to client only
+};
+
+// Client input validated and parsed on the network thread before global_lock is taken.
+struct PeerInput {
+    uint32_t peer;
+    // Index of the first event of the batch handed to handle_event after this input.
+    size_t event;
+    proto::UserUpdate update;
+};
+
+struct PeerState {
+    // Id of the peer's object.
+    uint32_t id;
+    PeerReplication replication;
+    TerrainStreamer terrain;
+    // Position of the peer's object on the terrain, refreshed every broadcast.
+    glm::vec3 focus = glm::vec3(0);
+    // Snapshot relay, has no object and no terrain stream.
+    bool relay = false;
+};
 
 uint64_t now() {
     return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::high_resolution_clock::now().time_since_epoch()).count();
@@ -23,156 +123,679 @@ uint64_t now() {
 void step(float delta) {
     const std::lock_guard<std::mutex> lock(global_lock);
 
-    for (auto& [id, object] : world_objects) {
-        object.position += object.velocity * delta;
+    npcs.Update(world, delta);
+    world.Step(delta);
+
+    {
+        const std::lock_guard<std::mutex> terrain_guard(terrain_lock);
+        terrain_collider.Collide(world);
+    }
+
+    world_history->Record(world);
+    // Reported when objects start to be dropped, not on every tick they are.
+    if (world_history->GetDropped() != world_history_dropped) {
+        if (world_history_dropped == 0) {
+            printf("World history holds %zu objects, %zu do not fit and are missing from rewound queries\n", world_history->GetMaxObjects(), world.Size() - world_history->GetMaxObjects());
+        }
+        world_history_dropped = world_history->GetDropped();
     }
 }
 
-void set_peer_id(ENetPeer* peer, uint32_t id) {
-    memcpy(&peer->data, &id, sizeof(uint32_t));
+void lockstep_step() {
+    const std::lock_guard<std::mutex> lock(global_lock);
+
+    lockstep_input.set_tick(lockstep->GetTick() + 1);
+    lockstep->Step(lockstep_input);
+    lockstep_input.set_hash(lockstep->Hash());
+    lockstep_frames.push_back(std::move(lockstep_input));
+    lockstep_input.Clear();
 }
 
-uint32_t get_peer_id(ENetPeer* peer) {
-    uint32_t id;
-    memcpy(&id, &peer->data, sizeof(uint32_t));
-    return id;
+void send(ITransport& transport, uint32_t peer, uint8_t channel, const google::protobuf::MessageLite& message, enet_uint32 flags) {
+    transport.Send(peer, channel, packet_pool.Create(message, flags));
 }
 
-void network() {
-    if (enet_initialize() != 0) {
-        std::cout << "An error occurred while initializing ENet." << std::endl;
-        abort();
+struct EventStats {
+    uint64_t wakeups = 0;
+    uint64_t events = 0;
+    size_t max_batch = 0;
+    // Dropped client packets.
+    uint64_t oversized = 0;
+    uint64_t rate_limited = 0;
+    uint64_t malformed = 0;
+    uint64_t last_report = 0;
+
+    void add_batch(size_t size) {
+        ++wakeups;
+        events += size;
+        max_batch = std::max(max_batch, size);
     }
 
-    ENetAddress address;
-    ENetHost* server;
-
-    address.host = ENET_HOST_ANY;
-    address.port = 8111;
-
-    server = enet_host_create(&address, 32, 2, 0, 0);
+    void report(uint64_t time) {
+        if (time - last_report < 1000000000) {
+            return;
+        }
+        if (wakeups > 0) {
+            printf("events: %llu in %llu wakeups, %.2f per wakeup, max batch %zu\n", (unsigned long long)events, (unsigned long long)wakeups, (double)events / wakeups, max_batch);
+        }
+        if (oversized + rate_limited + malformed > 0) {
+            printf("dropped input: %llu oversized, %llu rate limited, %llu malformed\n", (unsigned long long)oversized, (unsigned long long)rate_limited, (unsigned long long)malformed);
+        }
+        printf("packet pool: %llu hits, %llu misses, %llu outstanding\n", (unsigned long long)packet_pool.GetHits(), (unsigned long long)packet_pool.GetMisses(), (unsigned long long)packet_pool.GetOutstanding());
+        *this = EventStats();
+        last_report = time;
+    }
+};
+
+// Clock sync and terrain edits do not touch the world, handle them without taking global_lock.
+// Every client packet is size checked, rate limited and parsed here, UserUpdates are
+// appended to inputs and applied under the lock. Dropped packets are counted in stats.
+bool handle_unlocked(ITransport& transport, const TransportEvent& event, std::unordered_map<uint32_t, PeerLimits>& limits, std::vector<PeerInput>& inputs, size_t position, EventStats& stats) {
+    if (event.Type == TransportEventType::Connect) {
+        limits[event.Peer].relay = is_relay(event);
+    }
+    if (event.Type == TransportEventType::Disconnect) {
+        limits.erase(event.Peer);
+    }
+    if (event.Type != TransportEventType::Receive) {
+        return false;
+    }
 
-    if (!server) {
-        std::cout << "An error occurred while trying to create an ENet server host." << std::endl;
-        abort();
+    PeerLimits& peer_limits = limits.try_emplace(event.Peer).first->second;
+    if (event.Channel >= ChannelCount || event.Packet->dataLength > max_input_size[event.Channel]) {
+        ++stats.oversized;
+        enet_packet_destroy(event.Packet);
+        return true;
+    }
+    if (!peer_limits.input.Take(now())) {
+        ++stats.rate_limited;
+        enet_packet_destroy(event.Packet);
+        return true;
     }
 
-    std::cout << "ENet server started." << std::endl;
+    switch (event.Channel) {
+        case ChannelSnapshots: {
+            PeerInput& input = inputs.emplace_back();
+            input.peer = event.Peer;
+            input.event = position;
+            if (!input.update.ParseFromArray(event.Packet->data, event.Packet->dataLength)) {
+                ++stats.malformed;
+                inputs.pop_back();
+            }
+            break;
+        }
 
-    uint64_t lastTime = now();
-    ENetEvent event;
-    while (enet_host_service(server, &event, 10) >= 0) {
-        if (event.type == ENET_EVENT_TYPE_NONE && (now() - lastTime) < 10000000) {
-            continue;
+        case ChannelClock: {
+            proto::ClockSync sync;
+            if (sync.ParseFromArray(event.Packet->data, event.Packet->dataLength)) {
+                sync.set_server_time(now());
+                send(transport, event.Peer, ChannelClock, sync, ENET_PACKET_FLAG_UNSEQUENCED);
+            } else {
+                ++stats.malformed;
+            }
+            break;
         }
 
-        const std::lock_guard<std::mutex> lock(global_lock);
+        case ChannelTerrain: {
+            // Edits are appended to the log here and replicated with the next broadcast.
+            // Relays have no say in the world, their edits are ignored like their input.
+            if (peer_limits.relay) {
+                break;
+            }
+            proto::TerrainMessage message;
+            if (message.ParseFromArray(event.Packet->data, event.Packet->dataLength)) {
+                for (const proto::TerrainEdit& proto_edit : message.edits().edits()) {
+                    TerrainEdit edit;
+                    if (!TerrainEdit::Decode(proto_edit, edit)) {
+                        ++stats.malformed;
+                    } else if (!peer_limits.edits.Take(now())) {
+                        ++stats.rate_limited;
+                    } else {
+                        terrain_edits.Append(edit);
+                    }
+                }
+            } else {
+                ++stats.malformed;
+            }
+            break;
+        }
 
-        switch (event.type) {
-            case ENET_EVENT_TYPE_CONNECT: {
-                uint32_t id = next_id++;
-                set_peer_id(event.peer, id);
-                printf("A new client connected from %x:%u, setting id %d\n", event.peer->address.host, event.peer->address.port, id);
+        default:
+            ++stats.malformed;
+            break;
+    }
 
-                world_objects[id].id = id;
-                world_objects[id].color = Eigen::Vector3f((float)rand() / RAND_MAX, (float)rand() / RAND_MAX, (float)rand() / RAND_MAX);
-                objects_to_create.emplace(id);
+    enet_packet_destroy(event.Packet);
+    return true;
+}
+
+// Must be called with global_lock held.
+void handle_event(ITransport& transport, const TransportEvent& event, std::unordered_map<uint32_t, PeerState>& peers) {
+    switch (event.Type) {
+        case TransportEventType::Connect: {
+            if (event.Data != NoRelayKey && !is_relay(event)) {
+                printf("Peer %u connected with a wrong relay key, disconnecting\n", event.Peer);
+                transport.Disconnect(event.Peer);
+                break;
+            }
+            if (is_relay(event)) {
+                if (lockstep) {
+                    printf("Relays are not supported in lockstep mode, disconnecting peer %u\n", event.Peer);
+                    transport.Disconnect(event.Peer);
+                    break;
+                }
+                printf("A relay connected as peer %u\n", event.Peer);
+                peers.insert_or_assign(event.Peer, PeerState { 0, PeerReplication(), TerrainStreamer(terrain_stream_config), glm::vec3(0), true });
+                break;
+            }
+
+            if (lockstep) {
+                // The client starts from the current state, its own body joins with the next frame.
+                uint32_t id = lockstep_next_id++;
+                lockstep_input.add_joins(id);
+                peers.insert_or_assign(event.Peer, PeerState { id, PeerReplication(), TerrainStreamer(terrain_stream_config) });
+                printf("A new client connected as peer %u, setting lockstep id %d\n", event.Peer, id);
 
                 proto::ObjectsVector vector;
                 vector.add_me(id);
-                auto data = vector.SerializeAsString();
-                ENetPacket* packet = enet_packet_create(data.data(), data.size(), ENET_PACKET_FLAG_RELIABLE);
-                enet_peer_send(event.peer, 0, packet);
+                send(transport, event.Peer, ChannelSnapshots, vector, ENET_PACKET_FLAG_RELIABLE);
 
+                proto::LockstepMessage message;
+                lockstep->EncodeState(*message.mutable_state());
+                send(transport, event.Peer, ChannelLockstep, message, ENET_PACKET_FLAG_RELIABLE);
                 break;
             }
 
-            case ENET_EVENT_TYPE_RECEIVE: {
-                //printf("A packet of length %u containing %s was received from %s on channel %u.\n", event.packet->dataLength, event.packet->data, event.peer->data, event.channelID);
-                uint32_t id = get_peer_id(event.peer);
-                proto::UserUpdate uu;
-                uu.ParseFromArray(event.packet->data, event.packet->dataLength);
-                world_objects[id].velocity = Eigen::Vector2f(std::clamp(uu.velocity().x(), -1.0f, 1.0f), std::clamp(uu.velocity().y(), -1.0f, 1.0f)) * 10.0f;
-                world_objects[id].rotation = uu.rotation();
+            // Clients redirected from a neighbouring zone take over their handed off object.
+            uint32_t id;
+            if (!zone_manager || event.Data == 0 || !zone_manager->Claim(event.Data, id)) {
+                id = world.CreateObject().id;
+            }
+            if (zone_manager) {
+                zone_manager->AddPlayer(id);
+            }
+            printf("A new client connected as peer %u, setting id %d\n", event.Peer, id);
+            peers.insert_or_assign(event.Peer, PeerState { id, PeerReplication(), TerrainStreamer(terrain_stream_config) });
 
-                enet_packet_destroy(event.packet);
-                break;
+            proto::ObjectsVector vector;
+            vector.add_me(id);
+            send(transport, event.Peer, ChannelSnapshots, vector, ENET_PACKET_FLAG_RELIABLE);
+
+            break;
+        }
+
+        case TransportEventType::Receive:
+            // Client packets are all consumed by handle_unlocked.
+            enet_packet_destroy(event.Packet);
+            break;
+
+        case TransportEventType::Disconnect: {
+            auto it = peers.find(event.Peer);
+            if (it != peers.end() && it->second.relay) {
+                printf("Relay peer %u disconnected.\n", event.Peer);
+                peers.erase(it);
+            } else if (it != peers.end()) {
+                printf("%d disconnected.\n", it->second.id);
+                if (lockstep) {
+                    lockstep_input.add_leaves(it->second.id);
+                }
+                world.RemoveObject(it->second.id);
+                if (zone_manager) {
+                    zone_manager->RemovePlayer(it->second.id);
+                }
+                peers.erase(it);
             }
+            break;
+        }
+    }
+}
 
-            case ENET_EVENT_TYPE_DISCONNECT: {
-                uint32_t id = get_peer_id(event.peer);
-                printf("%d disconnected.\n", id);
-                world_objects.erase(id);
-                objects_to_delete.push_back(id);
-                break;
+// Must be called with global_lock held.
+void apply_input(const PeerInput& input, std::unordered_map<uint32_t, PeerState>& peers) {
+    auto it = peers.find(input.peer);
+    if (it == peers.end() || it->second.relay) {
+        return;
+    }
+    if (lockstep) {
+        LockstepSimulation::EncodeInput(it->second.id, input.update, lockstep_input.add_inputs());
+    } else {
+        world.ApplyUserUpdate(it->second.id, input.update);
+    }
+}
+
+// Must be called with global_lock held.
+void publish(ITransport& transport) {
+    // Every client gets the same frames, one shared packet each. Clients that joined
+    // after a frame was ticked skip it, their state already includes it.
+    if (lockstep) {
+        for (const proto::LockstepFrame& frame : lockstep_frames) {
+            proto::LockstepMessage message;
+            *message.mutable_frame() = frame;
+            transport.Broadcast(ChannelLockstep, packet_pool.Create(message, ENET_PACKET_FLAG_RELIABLE));
+        }
+        lockstep_frames.clear();
+        return;
+    }
+
+    // Pending creations and deletions go along with the copy.
+    published_world = world;
+    world.ClearPending();
+}
+
+// Encodes the published world for every peer in parallel, then sends the packets. Runs without global_lock.
+void broadcast(ITransport& transport, std::unordered_map<uint32_t, PeerState>& peers, uint64_t time) {
+    if (lockstep) {
+        return;
+    }
+
+    snapshot_jobs.clear();
+    for (auto& [peer, state] : peers) {
+        // Relays have no object and so no focus, they get every object at the full rate.
+        if (const Object* object = published_world.Find(state.id)) {
+            state.focus = glm::vec3(object->position.x(), 0.0f, object->position.y());
+            state.replication.SetFocus(object->position);
+        }
+        snapshot_jobs.push_back(SnapshotJob { peer, &state.replication });
+    }
+
+    snapshot_encoder.Encode(published_world, replication_config, time, snapshot_jobs);
+
+    for (const SnapshotJob& job : snapshot_jobs) {
+        for (ENetPacket* packet : job.Packets) {
+            transport.Send(job.Peer, ChannelSnapshots, packet);
+        }
+    }
+}
+
+// Terrain does not touch the world, chunks are generated and sent without global_lock.
+// The cache takes terrain_lock itself while its entries change.
+void stream_terrain(ITransport& transport, std::unordered_map<uint32_t, PeerState>& peers) {
+    // Chunks the simulation collides against next, so it never generates them itself.
+    if (!lockstep) {
+        terrain_collider.Prefetch(published_world);
+    }
+
+    if (sent_edit_sequence != terrain_edits.GetSequence()) {
+        terrain_cache.Refresh();
+
+        // Every peer gets every edit, the ones without the affected chunks ignore it.
+        // Chunks sent later already include it, edits and chunks share a reliable channel.
+        proto::TerrainMessage message;
+        auto [begin, end] = terrain_edits.GetEditsSince(sent_edit_sequence);
+        for (auto edit = begin; edit != end; ++edit) {
+            edit->Encode(message.mutable_edits()->add_edits());
+        }
+        sent_edit_sequence = terrain_edits.GetSequence();
+
+        transport.Broadcast(ChannelTerrain, packet_pool.Create(message, ENET_PACKET_FLAG_RELIABLE));
+
+        // Every edit has been sent and is in the cached chunks, new chunks start from the baselines.
+        if (terrain_edits.Size() > max_logged_edits) {
+            terrain_edits.Compact(terrain, sent_edit_sequence);
+        }
+    }
+
+    std::vector<const TerrainChunkCache::Entry*> chunks;
+    for (auto& [peer, state] : peers) {
+        if (state.relay) {
+            continue;
+        }
+        chunks.clear();
+        state.terrain.Collect(state.focus, terrain_cache, chunks);
+
+        for (const TerrainChunkCache::Entry* entry : chunks) {
+            proto::TerrainMessage message;
+            proto::TerrainChunk* chunk = message.mutable_chunk();
+            chunk->set_x(entry->Chunk.Coord.x);
+            chunk->set_y(entry->Chunk.Coord.y);
+            chunk->set_z(entry->Chunk.Coord.z);
+            chunk->set_data(entry->Compressed);
+            chunk->set_edit_sequence(entry->Chunk.EditSequence);
+
+            send(transport, peer, ChannelTerrain, message, ENET_PACKET_FLAG_RELIABLE);
+        }
+    }
+}
+
+// Connection to a neighbouring zone server. The upper zone of each pair listens on
+// ZonePort + its index, the lower one connects and retries until the upper one is up.
+struct ZoneLink {
+    std::unique_ptr<EnetTransport> transport;
+    std::optional<uint32_t> peer;
+    uint64_t retry = 0;
+};
+
+void poll_zones(std::array<ZoneLink, ZoneSides>& links, std::vector<std::pair<ZoneSide, TransportEvent>>& out) {
+    const ZoneConfig& config = zone_manager->GetConfig();
+    const uint32_t index = zone_manager->GetIndex();
+    std::vector<TransportEvent> events;
+
+    for (ZoneSide side : { ZoneLower, ZoneUpper }) {
+        if (!zone_manager->HasNeighbour(side)) {
+            continue;
+        }
+
+        ZoneLink& link = links[side];
+        if (!link.transport && now() >= link.retry) {
+            if (side == ZoneLower) {
+                link.transport = EnetTransport::Listen(config.ZonePort + index, 1);
+            } else {
+                link.transport = EnetTransport::Connect("127.0.0.1", config.ZonePort + index + 1);
             }
+            link.retry = now() + 1000000000;
+        }
+        if (!link.transport) {
+            continue;
+        }
 
-            default:
-                break;
+        events.clear();
+        link.transport->Service(events, 0);
+        for (const TransportEvent& event : events) {
+            out.emplace_back(side, event);
         }
+    }
+}
+
+// Must be called with global_lock held.
+void handle_zone_event(std::array<ZoneLink, ZoneSides>& links, ZoneSide side, const TransportEvent& event) {
+    ZoneLink& link = links[side];
+
+    switch (event.Type) {
+        case TransportEventType::Connect:
+            printf("Zone %u connected.\n", zone_manager->GetNeighbour(side));
+            link.peer = event.Peer;
+            zone_manager->SetConnected(world, side, true);
+            break;
+
+        case TransportEventType::Disconnect:
+            if (link.peer == event.Peer) {
+                printf("Zone %u disconnected.\n", zone_manager->GetNeighbour(side));
+                link.peer.reset();
+                zone_manager->SetConnected(world, side, false);
+            }
+            // A failed or lost outgoing connection is retried with a new host.
+            if (side == ZoneUpper) {
+                link.transport.reset();
+            }
+            break;
 
-        if ((now() - lastTime) < 10000000) {
+        case TransportEventType::Receive: {
+            proto::ZoneMessage message;
+            if (event.Channel == ChannelZone && message.ParseFromArray(event.Packet->data, event.Packet->dataLength)) {
+                zone_manager->Import(world, side, message, world.GetTime());
+            }
+            enet_packet_destroy(event.Packet);
+            break;
+        }
+    }
+}
+
+// Hands objects that crossed a border to the neighbours, mirrors border objects and
+// redirects clients whose object moved. Must be called with global_lock held.
+void exchange_zones(ITransport& transport, std::array<ZoneLink, ZoneSides>& links, std::unordered_map<uint32_t, PeerState>& peers) {
+    std::array<proto::ZoneMessage, ZoneSides> messages;
+    std::vector<ZonePlayerHandoff> players;
+    zone_manager->Export(world, world.GetTime(), messages, players);
+
+    for (ZoneSide side : { ZoneLower, ZoneUpper }) {
+        ZoneLink& link = links[side];
+        if (!link.peer) {
+            continue;
+        }
+        // Mirrors are refreshed every broadcast and may be lost, handoffs may not.
+        enet_uint32 flags = messages[side].handoffs_size() > 0 ? ENET_PACKET_FLAG_RELIABLE : 0;
+        link.transport->Send(*link.peer, ChannelZone, packet_pool.Create(messages[side], flags));
+    }
+
+    for (const ZonePlayerHandoff& player : players) {
+        auto it = std::find_if(peers.begin(), peers.end(), [&player](const auto& item) {
+            return item.second.id == player.Id;
+        });
+        if (it == peers.end()) {
             continue;
         }
 
-        lastTime = now();
+        proto::ZoneRedirect redirect;
+        redirect.set_zone(player.Zone);
+        redirect.set_port(zone_manager->GetConfig().ClientPort + player.Zone);
+        redirect.set_token(player.Token);
+        send(transport, it->first, ChannelZone, redirect, ENET_PACKET_FLAG_RELIABLE);
+
+        printf("%d handed off to zone %u.\n", player.Id, player.Zone);
+        peers.erase(it);
+    }
+}
 
-        auto add_object = [](const Object& object) {
-            proto::Object proto_object;
-            proto_object.set_id(object.id);
-            proto_object.mutable_color()->set_r(object.color.x());
-            proto_object.mutable_color()->set_g(object.color.y());
-            proto_object.mutable_color()->set_b(object.color.z());
-            proto_object.mutable_position()->set_x(object.position.x());
-            proto_object.mutable_position()->set_y(object.position.y());
-            proto_object.mutable_velocity()->set_x(object.velocity.x());
-            proto_object.mutable_velocity()->set_y(object.velocity.y());
-            proto_object.set_rotation(object.rotation);
-            return proto_object;
-        };
+void network(ITransport& transport) {
+    // Peers by transport handle.
+    std::unordered_map<uint32_t, PeerState> peers;
+    std::vector<TransportEvent> received;
+    std::vector<TransportEvent> events;
+    std::unordered_map<uint32_t, PeerLimits> input_limits;
+    std::vector<PeerInput> inputs;
+    EventStats stats;
+    std::array<ZoneLink, ZoneSides> zone_links;
+    std::vector<std::pair<ZoneSide, TransportEvent>> zone_events;
 
-        proto::ObjectsVector vector;
-        for (uint32_t id : objects_to_delete) {
-            vector.add_objects_to_delete(id);
+    uint64_t lastTime = now();
+    while (transport.Service(received, 10)) {
+        // The whole batch received by one wakeup is applied under a single lock acquisition.
+        events.clear();
+        inputs.clear();
+        if (!received.empty()) {
+            stats.add_batch(received.size());
+            for (const TransportEvent& event : received) {
+                if (!handle_unlocked(transport, event, input_limits, inputs, events.size(), stats)) {
+                    events.push_back(event);
+                }
+            }
+            received.clear();
         }
-        for (uint32_t id : objects_to_create) {
-            (*vector.add_objects()) = add_object(world_objects[id]);
+
+        zone_events.clear();
+        if (zone_manager) {
+            poll_zones(zone_links, zone_events);
         }
-        for (const auto& [id, object] : world_objects) {
-            if (!objects_to_create.contains(id)) {
-                (*vector.add_objects()) = add_object(world_objects[id]);
+
+        bool broadcast_due = (now() - lastTime) >= 10000000;
+        if (events.empty() && inputs.empty() && zone_events.empty() && !broadcast_due) {
+            continue;
+        }
+
+        {
+            const std::lock_guard<std::mutex> lock(global_lock);
+
+            // Inputs keep their place between the batch's connects and disconnects.
+            auto input = inputs.begin();
+            for (size_t i = 0; i < events.size(); ++i) {
+                for (; input != inputs.end() && input->event <= i; ++input) {
+                    apply_input(*input, peers);
+                }
+                handle_event(transport, events[i], peers);
+            }
+            for (; input != inputs.end(); ++input) {
+                apply_input(*input, peers);
+            }
+            for (const auto& [side, e] : zone_events) {
+                handle_zone_event(zone_links, side, e);
+            }
+
+            if (broadcast_due) {
+                lastTime = now();
+                if (zone_manager) {
+                    exchange_zones(transport, zone_links, peers);
+                }
+                publish(transport);
             }
         }
 
-        auto data = vector.SerializeAsString();
-        ENetPacket* packet = enet_packet_create(data.data(), data.size(), (objects_to_delete.empty() && objects_to_create.empty()) ? (ENET_PACKET_FLAG_UNRELIABLE_FRAGMENT | ENET_PACKET_FLAG_UNSEQUENCED) : ENET_PACKET_FLAG_RELIABLE);
-        enet_host_broadcast(server, 0, packet);
+        if (!broadcast_due) {
+            continue;
+        }
 
-        objects_to_create.clear();
-        objects_to_delete.clear();
+        broadcast(transport, peers, lastTime);
+        stream_terrain(transport, peers);
+        stats.report(lastTime);
     }
 
-    enet_host_destroy(server);
-    enet_deinitialize();
-
     stop = true;
 }
 
-int main() {
-    std::thread net_thread(&network);
+// In-process client driving a random walk, for running the server without sockets.
+void bot(LoopbackNetwork& network, LoopbackTransport& server_transport, LinkConditions conditions, uint32_t seed) {
+    LoopbackTransport transport(network, seed + 1);
+    uint32_t server = transport.Connect(server_transport, conditions);
+
+    ReplicationClient client;
+    std::mt19937 random(seed);
+    std::uniform_real_distribution<float> distribution(-1.0f, 1.0f);
+    std::vector<TransportEvent> events;
+    std::vector<Object> objects;
+    uint64_t last_input = 0;
+
+    while (!stop) {
+        events.clear();
+        transport.Service(events, 10);
+
+        uint64_t time = ReplicationClient::LocalTime();
+        for (const TransportEvent& event : events) {
+            if (event.Type == TransportEventType::Receive) {
+                client.HandlePacket(event.Channel, event.Packet, time);
+                enet_packet_destroy(event.Packet);
+            }
+        }
+
+        client.Update(transport, server, time);
+        objects.clear();
+        client.Sample(time, objects);
+
+        if (time - last_input >= 100000000) {
+            last_input = time;
+
+            proto::UserUpdate uu;
+            uu.mutable_velocity()->set_x(distribution(random));
+            uu.mutable_velocity()->set_y(distribution(random));
+            uu.set_rotation(distribution(random));
+            auto data = uu.SerializeAsString();
+            transport.Send(server, ChannelSnapshots, enet_packet_create(data.data(), data.size(), ENET_PACKET_FLAG_UNSEQUENCED));
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    // server [--zone i --zones n] [--lockstep] [--relay-key k] [npcs] [bots] [latency ms] [jitter ms] [loss %]
+    // With bots the server runs over the in-process loopback transport, without a socket,
+    // and the bots' links simulate the given one way latency, jitter and loss.
+    // With zones every process owns a strip of the world and serves clients on port 8111 + i.
+    // In lockstep mode client objects move in a deterministic fixed tick simulation and
+    // clients receive input frames instead of snapshots. NPCs and zones need the float world.
+    // Relays must connect with the non-zero 32-bit key given with --relay-key, without it none are accepted.
+    ZoneConfig zone_config;
+    uint32_t zone_index = 0;
+    std::vector<std::string> args;
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        if (arg == "--zone" && i + 1 < argc) {
+            zone_index = std::stoul(argv[++i]);
+        } else if (arg == "--zones" && i + 1 < argc) {
+            zone_config.Zones = std::stoul(argv[++i]);
+        } else if (arg == "--lockstep") {
+            lockstep = std::make_unique<LockstepSimulation>();
+        } else if (arg == "--relay-key" && i + 1 < argc) {
+            relay_key = (uint32_t)std::stoul(argv[++i], nullptr, 0);
+        } else {
+            args.push_back(arg);
+        }
+    }
+
+    size_t npc_count = args.size() > 0 ? std::stoul(args[0]) : 0;
+    size_t bot_count = args.size() > 1 ? std::stoul(args[1]) : 0;
+    LinkConditions conditions;
+    conditions.Latency = args.size() > 2 ? std::stoull(args[2]) * 1000000 : 0;
+    conditions.Jitter = args.size() > 3 ? std::stoull(args[3]) * 1000000 : 0;
+    conditions.Loss = args.size() > 4 ? std::stof(args[4]) / 100.0f : 0.0f;
+
+    // Objects beyond 25, 50 and 100 units of a client's object are checked at 1/2, 1/4 and 1/8 of the snapshot rate.
+    replication_config.UpdateRateDistances = { 25.0f, 50.0f, 100.0f };
+    // Late joiners get the world in MTU sized packets over several broadcasts, nearest objects first.
+    replication_config.MaxCreationsPerSnapshot = 256;
+
+    if (lockstep && (zone_config.Zones > 1 || npc_count > 0)) {
+        std::cout << "Lockstep mode supports neither zones nor NPCs." << std::endl;
+        return 1;
+    }
+
+    if (zone_config.Zones > 1) {
+        if (zone_index >= zone_config.Zones || bot_count > 0) {
+            std::cout << "Zones need a zone index below the zone count and the ENet transport." << std::endl;
+            return 1;
+        }
+        zone_manager = std::make_unique<ZoneManager>(zone_config, zone_index);
+        // Disjoint id ranges, objects keep their id when handed between zones.
+        world.SetNextId((zone_index << 24) + 1);
+    }
+
+    // Every zone draws the same positions and spawns the NPCs that fall into it.
+    for (size_t i = 0; i < npc_count; ++i) {
+        Eigen::Vector2f position = Eigen::Vector2f::Random() * 100.0f;
+        if (zone_manager && zone_manager->Owner(position.x()) != zone_index) {
+            continue;
+        }
+        uint32_t id = npcs.Spawn(world, position, i % 2 ? NpcBehavior::Flock : NpcBehavior::Wander);
+        if (zone_manager) {
+            zone_manager->Pin(id);
+        }
+    }
+    world.ClearPending();
+
+    // Every NPC of every zone may be mirrored here, plus the clients of every zone.
+    world_history = std::make_unique<WorldHistory>(64, npc_count + std::max(bot_count, max_clients) * zone_config.Zones);
+
+    LoopbackNetwork loopback;
+    std::unique_ptr<ITransport> transport;
+    std::vector<std::thread> bots;
+    if (bot_count > 0) {
+        auto server_transport = std::make_unique<LoopbackTransport>(loopback);
+        for (size_t i = 0; i < bot_count; ++i) {
+            bots.emplace_back(&bot, std::ref(loopback), std::ref(*server_transport), conditions, (uint32_t)i);
+        }
+        transport = std::move(server_transport);
+        std::cout << "Loopback server started with " << bot_count << " bots." << std::endl;
+    } else {
+        transport = EnetTransport::Listen(zone_config.ClientPort + zone_index, max_clients);
+        if (!transport) {
+            std::cout << "An error occurred while trying to create an ENet server host." << std::endl;
+            abort();
+        }
+        std::cout << "ENet server started on port " << zone_config.ClientPort + zone_index << "." << std::endl;
+    }
+
+    std::thread net_thread(&network, std::ref(*transport));
 
     uint64_t lastTime = now();
     while (!stop) {
         uint64_t currentTime = now();
-        float delta = (currentTime - lastTime) / 1000000000.0f;
-        lastTime = currentTime;
 
-        step(delta);
+        if (lockstep) {
+            // Fixed ticks, catching up if the thread slept too long.
+            while (currentTime - lastTime >= LockstepSimulation::DeltaNs) {
+                lockstep_step();
+                lastTime += LockstepSimulation::DeltaNs;
+            }
+        } else {
+            float delta = (currentTime - lastTime) / 1000000000.0f;
+            lastTime = currentTime;
+
+            step(delta);
+        }
 
         std::this_thread::sleep_for(std::chrono::milliseconds(10));
     }
 
     net_thread.join();
+    for (std::thread& thread : bots) {
+        thread.join();
+    }
 
     return 0;
 }